@@ -1,19 +1,51 @@
 #include "automata.h"
-
-[[nodiscard]] const char* too_many_states_exception::what() const noexcept {
-    return "Too many states in the automaton to calc DFA!\n";
-}
+#include "automaton_stats.h"
+#include "thread_pool.h"
+#include <chrono>
+#include <iterator>
+#include <mutex>
 
 [[nodiscard]] const char* too_many_start_states_exception::what() const noexcept {
     return "Too many start states in the automaton!\n";
 }
 
+[[nodiscard]] const char* not_deterministic_exception::what() const noexcept {
+    return "Automaton has to be deterministic with one-letter transitions to be compiled!\n";
+}
+
 
 
 // State
 
-const string& State::get_name() const {
-    return name;
+State::State(const vector<State>& source, const vector<size_t>& ids, const char* separator,
+             const bool& is_start, const bool& is_accept):
+        is_start(is_start),
+        is_accept(is_accept) {
+    vector<std::shared_ptr<const _Provenance>> parts;
+    parts.reserve(ids.size());
+    for (const size_t& i: ids) {
+        parts.push_back(source[i].provenance);
+    }
+    provenance = std::make_shared<const _Provenance>(_Provenance{"", std::move(parts), separator});
+}
+
+void State::_append_name(const _Provenance& node, string& result) {
+    if (node.parts.empty()) {
+        result += node.name;
+        return;
+    }
+    for (size_t i = 0; i < node.parts.size(); ++i) {
+        if (i != 0) {
+            result += node.separator;
+        }
+        _append_name(*node.parts[i], result);
+    }
+}
+
+string State::get_name() const {
+    string result;
+    _append_name(*provenance, result);
+    return result;
 }
 
 const bool& State::get_is_start() const {
@@ -24,25 +56,57 @@ const bool& State::get_is_accept() const {
     return is_accept;
 }
 
+const vector<size_t>& State::get_accept_ids() const {
+    return accept_ids;
+}
+
 void State::operator+=(const State& other) {
-    name += "+" + other.name;
+    provenance = std::make_shared<const _Provenance>(_Provenance{get_name() + "+" + other.get_name(), {}, ""});
     is_start |= other.is_start;
     is_accept |= other.is_accept;
+    if (!other.accept_ids.empty()) {
+        add_accept_ids(other.accept_ids);
+    }
 }
 
 void State::make_accept() {
     is_accept = true;
 }
 
+void State::add_accept_ids(const vector<size_t>& ids) {
+    is_accept = true;
+    vector<size_t> merged;
+    merged.reserve(accept_ids.size() + ids.size());
+    std::set_union(accept_ids.begin(), accept_ids.end(), ids.begin(), ids.end(), std::back_inserter(merged));
+    accept_ids = std::move(merged);
+}
 
 
-//_MinState
 
-_MinState::_MinState(const vector<size_t>& ach) {
-    for (const size_t& i: ach) {
-        achievable += char(i);
+// Замер фазы для AutomatonStats: без статистики и конструктор, и деструктор - одна проверка указателя
+class _PhaseTimer{
+    double* seconds;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    explicit _PhaseTimer(double* seconds): seconds(seconds) {
+        if (seconds) {
+            start = std::chrono::steady_clock::now();
+        }
     }
-}
+
+    ~_PhaseTimer() {
+        if (seconds) {
+            *seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+};
+
+
+
+//_MinState
+
+_MinState::_MinState(const vector<size_t>& ach): achievable(ach) {}
 
 bool _MinState::operator< (const _MinState& other) const {
     return achievable < other.achievable;
@@ -50,32 +114,106 @@ bool _MinState::operator< (const _MinState& other) const {
 
 
 
+//_Bitset
+
+_Bitset::_Bitset(const size_t& size): words((size + 63) / 64, 0) {}
+
+void _Bitset::set(const size_t& i) {
+    words[i / 64] |= 1ull << (i % 64);
+}
+
+void _Bitset::clear() {
+    std::fill(words.begin(), words.end(), 0);
+}
+
+bool _Bitset::test(const size_t& i) const {
+    return (words[i / 64] >> (i % 64)) & 1ull;
+}
+
+bool _Bitset::none() const {
+    for (const auto& word: words) {
+        if (word) {
+            return false;
+        }
+    }
+    return true;
+}
+
+size_t _Bitset::count() const {
+    size_t result = 0;
+    for (const auto& word: words) {
+        result += __builtin_popcountll(word);
+    }
+    return result;
+}
+
+const vector<unsigned long long>& _Bitset::get_words() const {
+    return words;
+}
+
+bool _Bitset::operator==(const _Bitset& other) const {
+    return words == other.words;
+}
+
+bool _Bitset::operator!=(const _Bitset& other) const {
+    return words != other.words;
+}
+
+_Bitset& _Bitset::operator|=(const _Bitset& other) {
+    if (words.size() < other.words.size()) {
+        words.resize(other.words.size(), 0);
+    }
+    for (size_t i = 0; i < other.words.size(); ++i) {
+        words[i] |= other.words[i];
+    }
+    return *this;
+}
+
+size_t _BitsetHash::operator()(const _Bitset& bitset) const {
+    unsigned long long hash = 14695981039346656037ull;
+    for (const auto& word: bitset.get_words()) {
+        hash ^= word;
+        hash *= 1099511628211ull;
+        hash ^= hash >> 29;
+    }
+    return hash;
+}
+
+
+
 //_DetState
 
+_DetState::_DetState(const size_t& size): mask(size), is_start(false), is_accept(false) {}
 
-_DetState::_DetState(): mask(0), is_start(false), is_accept(false) {}
+_DetState::_DetState(_Bitset mask, const bool& is_start, const bool& is_accept):
+        mask(std::move(mask)), is_start(is_start), is_accept(is_accept) {
+}
 
-_DetState::_DetState(const unsigned long long& mask, const bool& is_start, const bool& is_accept):
-        mask(mask), is_start(is_start), is_accept(is_accept) {
+void _DetState::add(const size_t& state, const bool& accept) {
+    mask.set(state);
+    is_accept |= accept;
 }
 
-//оператор, чтобы можно было запихнуть все это в set
-bool _DetState::operator<(const _DetState& other) const {
-    return mask < other.mask;
+bool _DetState::operator==(const _DetState& other) const {
+    return mask == other.mask;
 }
 
 _DetState _DetState::operator|(const _DetState& other) const {
-    return _DetState(mask | other.mask, false, is_accept | other.is_accept);
+    _DetState result(*this);
+    result.is_start = false;
+    result.mask |= other.mask;
+    result.is_accept |= other.is_accept;
+    return result;
 }
 
 _DetState& _DetState::operator|=(const _DetState& other) {
+    is_start = other.mask.none() && is_start;
     mask |= other.mask;
-    is_start = (other.mask == 0) && is_start;
     is_accept |= other.is_accept;
     return *this;
 }
 
-const unsigned long long& _DetState::get_mask() const {
+const _Bitset& _DetState::get_mask() const {
     return mask;
 }
 
@@ -136,7 +274,7 @@ void Automaton::output_states(std::ostream& stream) const {
     stream << "States: " << std::endl;
     for (size_t i = 0; i < states.size(); ++i) {
         auto st = states[i];
-        stream << i << ' ' << st.name << (st.get_is_start() ? " start": "")
+        stream << i << ' ' << st.get_name() << (st.get_is_start() ? " start": "")
                 << (st.get_is_accept() ? " accept ": "") << std::endl;
     }
     stream << '\n';
@@ -174,6 +312,15 @@ Automaton::Automaton(const vector<State>& states, const vector<set<Transition>>&
                 }
             }
         }
+        letters.assign(alphabet.begin(), alphabet.end());
+        letter_id.fill(NO_LETTER);
+        for (size_t i = 0; i < letters.size(); ++i) {
+            letter_id[static_cast<unsigned char>(letters[i][0])] = i;
+        }
+        letter_class.resize(letters.size());
+        for (size_t i = 0; i < letters.size(); ++i) {
+            letter_class[i] = i;
+        }
         for (size_t i = 0; i < states.size(); ++i) {
             if (states[i].get_is_start()) {
                 if (start_state == UINT32_MAX) {
@@ -183,10 +330,25 @@ Automaton::Automaton(const vector<State>& states, const vector<set<Transition>>&
                 }
             }
         }
+        // состояния без своего множества переходов (в конце списка) - без переходов
+        if (this->transitions.size() < states.size()) {
+            this->transitions.resize(states.size());
+        }
         _recalc_transition_number();
         _recalc_state_number();
     }
 
+// Автомат, про который заранее известно, что он детерминирован и с однобуквенными переходами
+Automaton Automaton::_from_dfa(const vector<State>& states, const vector<set<Transition>>& transitions) {
+    Automaton automaton(states, transitions);
+    automaton.is_one_letter = true;
+    automaton.is_DFA = true;
+    return automaton;
+}
+
+// Многобуквенные переходы из одного состояния раскладываются в бор: у переходов с общим префиксом
+// общие промежуточные состояния. Это не меняет язык: в промежуточные состояния бора ведут только
+// переходы из него самого, и они не принимающие
 void Automaton::_make_leq_one_letter() {
     auto original_state_number = states.size();
     for (size_t current_state = 0; current_state < original_state_number; ++current_state) {
@@ -196,157 +358,475 @@ void Automaton::_make_leq_one_letter() {
                 long_expr_transitions.push(current_state_transition);
             }
         }
+        map<pair<size_t, char>, size_t> trie;  // (узел, буква) -> промежуточное состояние; корень - current_state
         while (!long_expr_transitions.empty()) {
             Transition current_transition = long_expr_transitions.front();
             long_expr_transitions.pop();
             _delete_transition(current_state, current_transition);
+            const string& expr = current_transition.get_expr();
             size_t last = current_state;
-            for (size_t i = 0; i < current_transition.get_expr().size(); ++i) {
-                size_t new_state = states.size();
-                if (i + 1 == current_transition.get_expr().size()) {
-                    new_state = current_transition.get_finish();
-                } else {
-                    _add_state(std::to_string(new_state), false, false);
+            for (size_t i = 0; i + 1 < expr.size(); ++i) {
+                auto [node, is_new] = trie.emplace(std::make_pair(last, expr[i]), states.size());
+                if (is_new) {
+                    _add_state(std::to_string(node->second), false, false);
+                    _add_transition(last, node->second, expr.substr(i, 1));
                 }
-                _add_transition(last, new_state, current_transition.get_expr().substr(i, 1));
-                last = new_state;
+                last = node->second;
             }
+            _add_transition(last, current_transition.get_finish(), expr.substr(expr.size() - 1, 1));
         }
     }
 }
 
-void Automaton::_remove_epsilon_transitions() {
-    vector<set<Transition>> old_transitions(states.size());
-    transition_number = 0;
-    swap(old_transitions, transitions);
-    for (size_t current_state = 0; current_state < transitions.size(); ++current_state) {
-        _push_epsilon_transitions_in_state(current_state, old_transitions);
-    }
-    for (const auto& current_state_transitions: transitions) {
-        transition_number += current_state_transitions.size();
+// Компоненты сильной связности графа eps-переходов (алгоритм Тарьяна без рекурсии).
+// Компоненты нумеруются в порядке завершения, поэтому все eps-переходы ведут из компоненты
+// в компоненту с номером не больше её собственного
+vector<size_t> Automaton::_epsilon_components(size_t& component_number) const {
+    const size_t n = states.size();
+    const size_t UNVISITED = SIZE_MAX;
+    vector<size_t> component(n, UNVISITED), index(n, UNVISITED), low(n, 0);
+    vector<size_t> stack;
+    vector<pair<size_t, set<Transition>::const_iterator>> call_stack;
+    size_t counter = 0;
+    component_number = 0;
+    for (size_t root = 0; root < n; ++root) {
+        if (index[root] != UNVISITED) {
+            continue;
+        }
+        call_stack.emplace_back(root, transitions[root].begin());
+        index[root] = low[root] = counter++;
+        stack.push_back(root);
+        while (!call_stack.empty()) {
+            auto& [current_state, iter] = call_stack.back();
+            // пустые переходы в set<Transition> идут первыми
+            if (iter != transitions[current_state].end() && iter->get_expr().empty()) {
+                size_t next = iter->get_finish();
+                ++iter;
+                if (index[next] == UNVISITED) {
+                    index[next] = low[next] = counter++;
+                    stack.push_back(next);
+                    call_stack.emplace_back(next, transitions[next].begin());
+                } else if (component[next] == UNVISITED) {
+                    low[current_state] = std::min(low[current_state], index[next]);
+                }
+                continue;
+            }
+            size_t finished = current_state;
+            call_stack.pop_back();
+            if (!call_stack.empty()) {
+                low[call_stack.back().first] = std::min(low[call_stack.back().first], low[finished]);
+            }
+            if (low[finished] == index[finished]) {
+                size_t member;
+                do {
+                    member = stack.back();
+                    stack.pop_back();
+                    component[member] = component_number;
+                } while (member != finished);
+                ++component_number;
+            }
+        }
     }
+    return component;
 }
 
-void Automaton::_classify() {
-    vector<map<string, _DetState>> old_transition_packs_by_letter(transitions.size());
-    map<_DetState, int> renumeration;
-    vector<set<Transition>> old_transitions;
-    vector<State> old_states;
+// Eps-замыкание считается один раз на компоненту: замыкание компоненты - её состояния и замыкания
+// компонент, в которые из неё есть eps-переходы (они уже посчитаны, см. _epsilon_components)
+void Automaton::_remove_epsilon_transitions() {
+    const size_t n = states.size();
+    size_t component_number;
+    vector<size_t> component = _epsilon_components(component_number);
 
-    vector<_DetState> old_states_masks;
-    old_states_masks.reserve(states.size());
-    for (size_t i = 0; i < states.size(); ++i) {
-        old_states_masks.emplace_back(1u << i, states[i].get_is_start(), states[i].get_is_accept());
+    vector<vector<size_t>> members(component_number);
+    for (size_t i = 0; i < n; ++i) {
+        members[component[i]].push_back(i);
     }
+    // замыкание - отсортированный список состояний: плотные маски на n бит для каждой компоненты
+    // занимали бы O(n^2) памяти, хотя у большинства состояний пустых переходов нет вовсе
+    vector<vector<size_t>> closure(component_number);
+    for (size_t c = 0; c < component_number; ++c) {
+        closure[c] = members[c];
+        for (const size_t& i: members[c]) {
+            for (const auto& transition: transitions[i]) {
+                if (!transition.get_expr().empty()) {
+                    break;
+                }
+                if (component[transition.get_finish()] != c) {
+                    const auto& reachable = closure[component[transition.get_finish()]];
+                    closure[c].insert(closure[c].end(), reachable.begin(), reachable.end());
+                }
+            }
+        }
+        std::sort(closure[c].begin(), closure[c].end());
+        closure[c].erase(std::unique(closure[c].begin(), closure[c].end()), closure[c].end());
+    }
+
+    // новые переходы нужны только компонентам с пустыми переходами; остальные состояния остаются как есть,
+    // а старые переходы читаются до конца, поэтому новые записываются после
+    const vector<set<Transition>>& old_transitions = transitions;
+    vector<pair<size_t, set<Transition>>> rebuilt;
+    vector<pair<size_t, size_t>> collected;
+    vector<size_t> collected_ids;
+    for (size_t c = 0; c < component_number; ++c) {
+        const auto& own = transitions[closure[c][0]];
+        if (closure[c].size() == 1 && (own.empty() || !own.begin()->get_expr().empty())) {
+            continue;
+        }
+        collected.clear();
+        collected_ids.clear();
+        bool is_accept = false;
+        for (const size_t& i: closure[c]) {
+            is_accept = is_accept || states[i].get_is_accept();
+            const auto& ids = states[i].get_accept_ids();
+            collected_ids.insert(collected_ids.end(), ids.begin(), ids.end());
+            for (const auto& transition: old_transitions[i]) {
+                if (!transition.get_expr().empty()) {
+                    collected.emplace_back(letter_id[static_cast<unsigned char>(transition.get_expr()[0])],
+                                           transition.get_finish());
+                }
+            }
+        }
+        std::sort(collected.begin(), collected.end());
+        collected.erase(std::unique(collected.begin(), collected.end()), collected.end());
+        set<Transition> component_transitions;
+        for (const auto& [letter, finish]: collected) {
+            component_transitions.emplace_hint(component_transitions.end(), letters[letter], finish);
+        }
+        rebuilt.emplace_back(c, std::move(component_transitions));
+        if (is_accept) {
+            std::sort(collected_ids.begin(), collected_ids.end());
+            collected_ids.erase(std::unique(collected_ids.begin(), collected_ids.end()), collected_ids.end());
+            for (const size_t& i: members[c]) {
+                states[i].make_accept();
+                if (!collected_ids.empty()) {
+                    states[i].add_accept_ids(collected_ids);
+                }
+            }
+        }
+    }
+    for (auto& [c, component_transitions]: rebuilt) {
+        for (size_t k = 0; k + 1 < members[c].size(); ++k) {
+            transitions[members[c][k]] = component_transitions;
+        }
+        transitions[members[c].back()] = std::move(component_transitions);
+    }
+    _recalc_transition_number();
+}
 
+// переходы автомата в виде (номер буквы, куда); буквы не-представители классов ведут себя
+// так же, как их представитель, поэтому подмножества считаются только для представителей
+vector<vector<pair<size_t, size_t>>> Automaton::_transitions_by_class_letter() const {
+    vector<vector<pair<size_t, size_t>>> result(transitions.size());
     for (size_t i = 0; i < transitions.size(); ++i) {
+        result[i].reserve(transitions[i].size());
         for (const auto& current_transition: transitions[i]) {
-            old_transition_packs_by_letter[i][current_transition.get_expr()] |= old_states_masks[current_transition.get_finish()];
+            size_t letter = letter_id[static_cast<unsigned char>(current_transition.get_expr()[0])];
+            if (letter_class[letter] == letter) {
+                result[i].emplace_back(letter, current_transition.get_finish());
+            }
         }
     }
+    return result;
+}
+
+vector<vector<size_t>> Automaton::_class_letters() const {
+    vector<vector<size_t>> result(letters.size());
+    for (size_t letter = 0; letter < letters.size(); ++letter) {
+        result[letter_class[letter]].push_back(letter);
+    }
+    return result;
+}
 
-    queue<_DetState> pack_states;
-    map<_DetState, bool> used;
-    size_t new_state_number = 1;
-    _DetState new_start_state(1u << start_state, true, states[start_state].get_is_accept());
-    pack_states.push(_DetState(new_start_state));
-    renumeration[new_start_state] = new_state_number;
-    ++new_state_number;
+void Automaton::_classify() {
+    // без стартового состояния нет и достижимых подмножеств: остаётся автомат без состояний
+    if (start_state >= states.size()) {
+        states.clear();
+        transitions.clear();
+        state_number = transition_number = 0;
+        return;
+    }
+    _build_letter_classes();
+    auto old_transitions_by_letter = _transitions_by_class_letter();
+    auto class_letters = _class_letters();
 
+    vector<set<Transition>> old_transitions;
+    vector<State> old_states;
     swap(old_states, states);
     state_number = 0;
     swap(old_transitions, transitions);
     transition_number = 0;
 
-    _add_state(_build_name_by_mask(1u << start_state, old_states), true, old_states[start_state].get_is_accept());
-
-    while (!pack_states.empty()) {
-        auto current_state = pack_states.front();
-        pack_states.pop();
-        unsigned long long current_mask;
-        if (!used[current_state]) {
-            used[current_state] = true;
-            for (const string& letter: alphabet) {
-                _DetState current_state_pack; // все достижимые состояния по данному символу
-                current_mask = current_state.get_mask();
-                for (size_t i = 0; 1u<<i <= current_mask; ++i) {
-                    if (1u<<i & current_mask) {
-                        current_state_pack |= old_transition_packs_by_letter[i][letter];
-                    }
+    // каждое подмножество хранится один раз: ключом в renumeration, а очередь - это номера новых состояний
+    std::unordered_map<_Bitset, size_t, _BitsetHash> renumeration;
+    vector<const _Bitset*> pack_states;
+
+    _DetState new_start_state(old_states.size());
+    new_start_state.add(start_state, old_states[start_state].get_is_accept());
+    auto inserted = renumeration.emplace(new_start_state.get_mask(), 0).first;
+    pack_states.push_back(&inserted->first);
+    _add_state(_subset_state(old_states, inserted->first, true, new_start_state.get_is_accept()));
+
+    vector<_DetState> current_state_packs(letters.size(), _DetState(old_states.size()));
+    vector<size_t> touched_letters;
+    vector<bool> is_touched(letters.size(), false);
+    size_t lookups = 1;
+    for (size_t current_state = 0; current_state < pack_states.size(); ++current_state) {
+        // все достижимые состояния по каждому символу
+        pack_states[current_state]->for_each([&](size_t i) {
+            for (const auto& [letter, finish]: old_transitions_by_letter[i]) {
+                if (!is_touched[letter]) {
+                    is_touched[letter] = true;
+                    touched_letters.push_back(letter);
                 }
-                if (current_state_pack.get_mask()) {
-                    if (renumeration[current_state_pack] == 0) {
-                        renumeration[current_state_pack] = new_state_number;
-                        ++new_state_number;
-                        _add_state(_build_name_by_mask(current_state_pack.get_mask(), old_states),
-                                                current_state_pack.get_is_start(),
-                                                current_state_pack.get_is_accept());
+                current_state_packs[letter].add(finish, old_states[finish].get_is_accept());
+            }
+        });
+        std::sort(touched_letters.begin(), touched_letters.end());
+        lookups += touched_letters.size();
+        for (const size_t& letter: touched_letters) {
+            auto& current_state_pack = current_state_packs[letter];
+            auto [iter, is_new] = renumeration.emplace(current_state_pack.get_mask(), pack_states.size());
+            if (is_new) {
+                pack_states.push_back(&iter->first);
+                _add_state(_subset_state(old_states, iter->first, false, current_state_pack.get_is_accept()));
+            }
+            for (const size_t& same_letter: class_letters[letter]) {
+                _add_transition(current_state, iter->second, letters[same_letter]);
+            }
+            current_state_pack = _DetState(old_states.size());
+            is_touched[letter] = false;
+        }
+        touched_letters.clear();
+    }
+    if (stats) {
+        stats->map_lookups += lookups;
+        stats->subset_states_created += pack_states.size();
+        stats->duplicate_subsets += lookups - pack_states.size();
+    }
+}
+
+
+
+// Подмножества раскрываются по уровням обхода в ширину: потоки пула берут состояния текущего уровня
+// и кладут новые подмножества в разбитую на части хеш-таблицу. Номера, которые выдаёт таблица, зависят
+// от порядка работы потоков, поэтому в конце состояния перенумеровываются обходом в ширину в порядке
+// букв - получается ровно та же нумерация, что и у последовательного _classify
+void Automaton::_classify_parallel(ThreadPool& pool) {
+    // без стартового состояния нет и достижимых подмножеств: остаётся автомат без состояний
+    if (start_state >= states.size()) {
+        states.clear();
+        transitions.clear();
+        state_number = transition_number = 0;
+        return;
+    }
+    _build_letter_classes();
+    auto old_transitions_by_letter = _transitions_by_class_letter();
+    auto class_letters = _class_letters();
+    const size_t old_size = states.size();
+
+    static const size_t SHARDS = 64;
+    struct Shard{
+        std::mutex mutex;
+        std::unordered_map<_Bitset, size_t, _BitsetHash> ids;
+        vector<const _Bitset*> subsets;
+    };
+    vector<Shard> shards(SHARDS);
+    auto intern = [&](_Bitset subset) -> pair<size_t, bool> {
+        size_t shard = _BitsetHash()(subset) % SHARDS;
+        std::lock_guard<std::mutex> lock(shards[shard].mutex);
+        auto [iter, is_new] = shards[shard].ids.emplace(std::move(subset), shards[shard].subsets.size() * SHARDS + shard);
+        if (is_new) {
+            shards[shard].subsets.push_back(&iter->first);
+        }
+        return {iter->second, is_new};
+    };
+    auto subset_by_id = [&](const size_t& id) {
+        return shards[id % SHARDS].subsets[id / SHARDS];
+    };
+
+    _Bitset start_subset(old_size);
+    start_subset.set(start_state);
+    size_t start_id = intern(std::move(start_subset)).first;
+
+    // edges[id] - переходы (буква, id) раскрытого подмножества в порядке букв
+    std::unordered_map<size_t, vector<pair<size_t, size_t>>> edges;
+    vector<size_t> frontier = {start_id};
+    while (!frontier.empty()) {
+        // указатели на ключи хеш-таблицы не меняются, а векторы subsets могут расти во время уровня
+        vector<const _Bitset*> frontier_subsets;
+        frontier_subsets.reserve(frontier.size());
+        for (const size_t& id: frontier) {
+            frontier_subsets.push_back(subset_by_id(id));
+        }
+        vector<vector<pair<size_t, size_t>>> level_edges(frontier.size());
+        vector<vector<size_t>> level_new(frontier.size());
+        pool.parallel_for(frontier.size(), 1, [&](size_t begin, size_t end) {
+            vector<_Bitset> current_state_packs(letters.size(), _Bitset(old_size));
+            vector<size_t> touched_letters;
+            vector<bool> is_touched(letters.size(), false);
+            for (size_t index = begin; index < end; ++index) {
+                frontier_subsets[index]->for_each([&](size_t i) {
+                    for (const auto& [letter, finish]: old_transitions_by_letter[i]) {
+                        if (!is_touched[letter]) {
+                            is_touched[letter] = true;
+                            touched_letters.push_back(letter);
+                        }
+                        current_state_packs[letter].set(finish);
                     }
-                    _add_transition(renumeration[current_state] - 1, renumeration[current_state_pack] - 1, letter);
-                    pack_states.push(current_state_pack);
+                });
+                std::sort(touched_letters.begin(), touched_letters.end());
+                for (const size_t& letter: touched_letters) {
+                    auto [id, is_new] = intern(current_state_packs[letter]);
+                    level_edges[index].emplace_back(letter, id);
+                    if (is_new) {
+                        level_new[index].push_back(id);
+                    }
+                    current_state_packs[letter].clear();
+                    is_touched[letter] = false;
                 }
+                touched_letters.clear();
             }
+        });
+        vector<size_t> next_frontier;
+        for (size_t index = 0; index < frontier.size(); ++index) {
+            edges[frontier[index]] = std::move(level_edges[index]);
+            next_frontier.insert(next_frontier.end(), level_new[index].begin(), level_new[index].end());
         }
+        swap(frontier, next_frontier);
     }
-}
 
+    // детерминированная нумерация
+    std::unordered_map<size_t, size_t> renumeration;
+    vector<size_t> order = {start_id};
+    renumeration[start_id] = 0;
+    for (size_t current = 0; current < order.size(); ++current) {
+        for (const auto& [letter, id]: edges[order[current]]) {
+            if (renumeration.emplace(id, order.size()).second) {
+                order.push_back(id);
+            }
+        }
+    }
 
+    vector<set<Transition>> old_transitions;
+    vector<State> old_states;
+    swap(old_states, states);
+    state_number = 0;
+    swap(old_transitions, transitions);
+    transition_number = 0;
+
+    for (size_t current = 0; current < order.size(); ++current) {
+        const _Bitset& subset = *subset_by_id(order[current]);
+        bool is_accept = false;
+        subset.for_each([&](size_t i) { is_accept = is_accept || old_states[i].get_is_accept(); });
+        _add_state(_subset_state(old_states, subset, current == 0, is_accept));
+    }
+    for (size_t current = 0; current < order.size(); ++current) {
+        for (const auto& [letter, id]: edges[order[current]]) {
+            for (const size_t& same_letter: class_letters[letter]) {
+                _add_transition(current, renumeration[id], letters[same_letter]);
+            }
+        }
+    }
+    if (stats) {
+        size_t lookups = 1;
+        for (const auto& [id, subset_edges]: edges) {
+            lookups += subset_edges.size();
+        }
+        stats->map_lookups += lookups;
+        stats->subset_states_created += order.size();
+        stats->duplicate_subsets += lookups - order.size();
+    }
+}
 
 void Automaton::determinize() {
-    if (states.size() > MAX_AUTOMATA_SIZE) {
-        throw too_many_states_exception();
+    if (is_DFA) {
+        return;
+    }
+    make_one_letter();
+    {
+        _PhaseTimer timer(stats ? &stats->subset_construction_seconds : nullptr);
+        _classify();
+    }
+    is_DFA = true;
+    if (stats) {
+        stats->update_peak_memory();
     }
+}
+
+void Automaton::determinize(ThreadPool& pool) {
     if (is_DFA) {
         return;
     }
     make_one_letter();
-    _classify();
+    {
+        _PhaseTimer timer(stats ? &stats->subset_construction_seconds : nullptr);
+        _classify_parallel(pool);
+    }
     is_DFA = true;
+    if (stats) {
+        stats->update_peak_memory();
+    }
 }
 
-void Automaton::_push_epsilon_transitions_in_state(const size_t& current_state, const vector<set<Transition>>& old_transitions) {
-    vector<bool> used(states.size(), false);
-    queue<int> reachable;
-    reachable.push(current_state);
-    while (!reachable.empty()) {
-        int s = reachable.front();
-        reachable.pop();
-        if (used[s]) {
-            continue;
-        }
-        used[s] = true;
-        transitions[current_state].insert(old_transitions[s].begin(), old_transitions[s].end());
-        for (const auto& current_transition: old_transitions[s]) {
-            if (!current_transition.get_expr().empty()) {
-                break;
+// Обход пар (состояние, позиция в слове): работает и для НКА с многобуквенными и пустыми переходами
+bool Automaton::accepts(std::string_view word) const {
+    if (start_state >= states.size()) {
+        return false;
+    }
+    map<size_t, vector<size_t>> pending;  // позиция -> состояния, в которые в неё пришли
+    pending[0].push_back(start_state);
+    _Bitset visited(states.size());
+    while (!pending.empty()) {
+        auto [position, reachable] = *pending.begin();
+        pending.erase(pending.begin());
+        visited.clear();
+        while (!reachable.empty()) {
+            size_t current_state = reachable.back();
+            reachable.pop_back();
+            if (visited.test(current_state)) {
+                continue;
+            }
+            visited.set(current_state);
+            if (position == word.size() && states[current_state].get_is_accept()) {
+                return true;
             }
-            reachable.push(current_transition.get_finish());
-            if (states[current_transition.get_finish()].get_is_accept()) {
-                states[current_state].make_accept();
+            for (const auto& transition: transitions[current_state]) {
+                const string& expr = transition.get_expr();
+                if (expr.empty()) {
+                    reachable.push_back(transition.get_finish());
+                } else if (word.compare(position, expr.size(), expr) == 0) {
+                    pending[position + expr.size()].push_back(transition.get_finish());
+                }
             }
         }
     }
-    auto iter = transitions[current_state].begin();
-    while (iter != transitions[current_state].end() && iter->get_expr().empty()) {
-        auto copy_iter = iter;
-        ++iter;
-        transitions[current_state].erase(copy_iter);
-    }
+    return false;
 }
 
-string Automaton::_build_name_by_mask(const unsigned long long& mask, const vector<State>& old_states, const string& separator) {
-    vector<string> names;
-    for (size_t i = 0; 1u<<i <= mask; ++i) {
-        if (1u<<i & mask) {
-            names.push_back(old_states[i].get_name());
-        }
+// Подмножество из одного состояния просто наследует его имя - так не нужен отдельный источник имени
+State Automaton::_subset_state(const vector<State>& source, const _Bitset& mask,
+                               const bool& is_start, const bool& is_accept) {
+    vector<size_t> ids;
+    ids.reserve(mask.count());
+    vector<size_t> accept_ids;
+    mask.for_each([&](size_t i) {
+        ids.push_back(i);
+        const auto& member_ids = source[i].get_accept_ids();
+        accept_ids.insert(accept_ids.end(), member_ids.begin(), member_ids.end());
+    });
+    if (ids.size() == 1) {
+        State state = source[ids[0]];
+        state.is_start = is_start;
+        state.is_accept = is_accept;
+        return state;
     }
-    string new_name;
-    for (size_t i = 0; i + 1 < names.size(); ++i) {
-        new_name += names[i] + separator;
+    State state(source, ids, "", is_start, is_accept);
+    if (!accept_ids.empty()) {
+        std::sort(accept_ids.begin(), accept_ids.end());
+        accept_ids.erase(std::unique(accept_ids.begin(), accept_ids.end()), accept_ids.end());
+        state.add_accept_ids(accept_ids);
     }
-    new_name += names.back();
-    return new_name;
+    return state;
 }
 
 void Automaton::tex_graph_print(std::ostream & stream) const {
@@ -412,26 +892,293 @@ void Automaton::tex_transition_table_print(std::ostream & stream) const {
     stream << " \\hline\n \\end{tabular} \n";
 }
 
+void Automaton::cpp_matcher_print(std::ostream & stream, const string& function_name, bool tables) const {
+    // targets[state] - переходы по байтам, сгруппированные по состоянию, куда ведут
+    vector<map<size_t, vector<unsigned char>>> targets(states.size());
+    vector<bool> referenced(states.size(), false);
+    for (size_t i = 0; i < states.size(); ++i) {
+        set<unsigned char> seen;
+        for (const auto& transition: transitions[i]) {
+            const auto& expr = transition.get_expr();
+            if (expr.size() != 1 || !seen.insert(expr[0]).second) {
+                throw not_deterministic_exception();
+            }
+            targets[i][transition.get_finish()].push_back(expr[0]);
+            referenced[transition.get_finish()] = true;
+        }
+    }
 
-void Automaton::minimize(bool print_log, std::ostream& stream) {
-    if (state_number > MAX_AUTOMATA_SIZE) {
-        throw too_many_states_exception();
+    stream << "// Generated from a DFA with " << states.size() << " states\n";
+    stream << "inline bool " << function_name << "(std::string_view word) {\n";
+    if (start_state >= states.size()) {
+        stream << "    return false;\n}\n";
+        return;
+    }
+    if (tables) {
+        // лишняя строка states.size() - мёртвое состояние для байтов без перехода
+        const size_t dead = states.size();
+        const char* type = dead < 256 ? "std::uint8_t" : dead < 65536 ? "std::uint16_t" : "std::uint32_t";
+        stream << "    static constexpr " << type << " next[][256] = {\n";
+        for (size_t i = 0; i <= dead; ++i) {
+            vector<size_t> row(256, dead);
+            if (i < dead) {
+                for (const auto& [finish, bytes]: targets[i]) {
+                    for (const auto& byte: bytes) {
+                        row[byte] = finish;
+                    }
+                }
+            }
+            stream << "        {";
+            for (size_t byte = 0; byte < 256; ++byte) {
+                stream << (byte ? ", " : "") << row[byte];
+            }
+            stream << "},\n";
+        }
+        stream << "    };\n    static constexpr bool accept[] = {";
+        for (size_t i = 0; i <= dead; ++i) {
+            stream << (i ? ", " : "") << (i < dead && states[i].get_is_accept() ? "true" : "false");
+        }
+        stream << "};\n"
+                  "    " << type << " state = " << start_state << ";\n"
+                  "    for (const char c: word) {\n"
+                  "        state = next[state][static_cast<unsigned char>(c)];\n"
+                  "    }\n"
+                  "    return accept[state];\n"
+                  "}\n";
+        return;
     }
+    referenced[start_state] = true;
+    stream << "    const unsigned char* p = reinterpret_cast<const unsigned char*>(word.data());\n"
+              "    const unsigned char* const end = p + word.size();\n"
+              "    goto state_" << start_state << ";\n";
+    for (size_t i = 0; i < states.size(); ++i) {
+        if (!referenced[i]) {
+            continue;
+        }
+        stream << "state_" << i << ":\n";
+        // из непринимающего состояния с петлями по всем переходам уже не выбраться
+        if (!states[i].get_is_accept() && (targets[i].empty() || (targets[i].size() == 1 && targets[i].begin()->first == i))) {
+            stream << "    return false;\n";
+            continue;
+        }
+        stream << "    if (p == end) {\n"
+                  "        return " << (states[i].get_is_accept() ? "true" : "false") << ";\n"
+                  "    }\n"
+                  "    switch (*p++) {\n";
+        for (const auto& [finish, bytes]: targets[i]) {
+            for (const auto& byte: bytes) {
+                stream << "        case " << static_cast<unsigned>(byte) << ":\n";
+            }
+            stream << "            goto state_" << finish << ";\n";
+        }
+        stream << "        default:\n"
+                  "            return false;\n"
+                  "    }\n";
+    }
+    stream << "}\n";
+}
+
+
+void Automaton::minimize(bool print_log, std::ostream& stream) {
     if (is_minimum) {
         return;
     }
     is_minimum = true;
     complete(); // после этого можем быть уверены, что для каждой буквы есть переход + они будут отсортированы по этим буквам
+    _build_letter_classes();
 
+    // лог строится по раундам Мура, поэтому считаем его только по запросу
+    {
+        _PhaseTimer timer(stats ? &stats->refinement_seconds : nullptr);
+        if (print_log) {
+            _merge_states_by_types(_moore_types(print_log, stream));
+        } else {
+            _merge_states_by_types(_hopcroft_types());
+        }
+    }
+    if (stats) {
+        stats->update_peak_memory();
+    }
+}
+
+void Automaton::minimize_partial() {
+    determinize();
+    {
+        _PhaseTimer timer(stats ? &stats->refinement_seconds : nullptr);
+        _merge_states_by_types(_valmari_types());
+    }
+    is_complete = false;
+    is_minimum = false;
+    if (stats) {
+        stats->update_peak_memory();
+    }
+}
+
+vector<size_t> Automaton::_hopcroft_types() const {
+    const size_t n = states.size();
+
+    // сплиттеры нужны только по одной букве из каждого класса
+    vector<size_t> class_by_letter(letters.size());
+    size_t k = 0;
+    for (size_t letter = 0; letter < letters.size(); ++letter) {
+        class_by_letter[letter] = (letter_class[letter] == letter) ? k++ : class_by_letter[letter_class[letter]];
+    }
+
+    // обратные переходы по каждому классу букв в формате CSR: inverse[inverse_start[a * n + s]...] - откуда можно прийти в s по a
+    vector<size_t> inverse_start(n * k + 1, 0);
+    for (size_t s = 0; s < n; ++s) {
+        size_t letter = 0;
+        for (const auto& transition: transitions[s]) {
+            if (letter_class[letter] == letter) {
+                ++inverse_start[class_by_letter[letter] * n + transition.get_finish() + 1];
+            }
+            ++letter;
+        }
+    }
+    for (size_t i = 0; i < n * k; ++i) {
+        inverse_start[i + 1] += inverse_start[i];
+    }
+    vector<size_t> inverse(inverse_start.back());
+    vector<size_t> filled(inverse_start.begin(), inverse_start.end() - 1);
+    for (size_t s = 0; s < n; ++s) {
+        size_t letter = 0;
+        for (const auto& transition: transitions[s]) {
+            if (letter_class[letter] == letter) {
+                inverse[filled[class_by_letter[letter] * n + transition.get_finish()]++] = s;
+            }
+            ++letter;
+        }
+    }
+
+    // разбиение: блок - отрезок [first, last) массива elements, состояния в начале отрезка помечены
+    // в начальном разбиении принимающие состояния разделены ещё и по наборам номеров шаблонов
+    vector<size_t> elements(n), location(n), block(n);
+    vector<size_t> first, last, marked;
+    size_t accept_class_number;
+    vector<size_t> accept_class = _accept_classes(accept_class_number);
+    for (size_t accept = 0; accept < accept_class_number; ++accept) {
+        size_t begin = first.empty() ? 0 : last.back();
+        size_t end = begin;
+        for (size_t s = 0; s < n; ++s) {
+            if (accept_class[s] == accept) {
+                elements[end] = s;
+                location[s] = end;
+                block[s] = first.size();
+                ++end;
+            }
+        }
+        if (end != begin) {
+            first.push_back(begin);
+            last.push_back(end);
+            marked.push_back(0);
+        }
+    }
+
+    // сплиттерами становятся все начальные блоки, кроме самого большого
+    queue<pair<size_t, size_t>> splitters;
+    vector<vector<bool>> in_splitters(first.size(), vector<bool>(k, false));
+    size_t largest = 0;
+    for (size_t b = 1; b < first.size(); ++b) {
+        if (last[b] - first[b] > last[largest] - first[largest]) {
+            largest = b;
+        }
+    }
+    for (size_t b = 0; b < first.size(); ++b) {
+        if (b == largest) {
+            continue;
+        }
+        for (size_t letter = 0; letter < k; ++letter) {
+            splitters.emplace(b, letter);
+            in_splitters[b][letter] = true;
+        }
+    }
+
+    vector<size_t> predecessors;
+    vector<size_t> touched_blocks;
+    size_t rounds = 0;
+    while (!splitters.empty()) {
+        auto [splitter, letter] = splitters.front();
+        splitters.pop();
+        ++rounds;
+        in_splitters[splitter][letter] = false;
+
+        predecessors.clear();
+        for (size_t i = first[splitter]; i < last[splitter]; ++i) {
+            size_t s = elements[i];
+            for (size_t j = inverse_start[letter * n + s]; j < inverse_start[letter * n + s + 1]; ++j) {
+                predecessors.push_back(inverse[j]);
+            }
+        }
+        for (const size_t& p: predecessors) {
+            size_t b = block[p];
+            size_t position = first[b] + marked[b];
+            if (location[p] < position) {
+                continue; // уже помечено
+            }
+            if (marked[b] == 0) {
+                touched_blocks.push_back(b);
+            }
+            std::swap(elements[location[p]], elements[position]);
+            location[elements[location[p]]] = location[p];
+            location[p] = position;
+            ++marked[b];
+        }
+        for (const size_t& b: touched_blocks) {
+            size_t split = first[b] + marked[b];
+            marked[b] = 0;
+            if (split == last[b]) {
+                continue;
+            }
+            size_t new_block = first.size();
+            first.push_back(first[b]);
+            last.push_back(split);
+            marked.push_back(0);
+            first[b] = split;
+            for (size_t i = first[new_block]; i < last[new_block]; ++i) {
+                block[elements[i]] = new_block;
+            }
+            in_splitters.emplace_back(k, false);
+            bool new_is_smaller = last[new_block] - first[new_block] <= last[b] - first[b];
+            for (size_t c = 0; c < k; ++c) {
+                size_t added = (in_splitters[b][c] || new_is_smaller) ? new_block : b;
+                if (!in_splitters[added][c]) {
+                    in_splitters[added][c] = true;
+                    splitters.emplace(added, c);
+                }
+            }
+        }
+        touched_blocks.clear();
+    }
+    if (stats) {
+        stats->refinement_rounds += rounds;
+    }
+
+    // нумеруем классы с единицы в порядке первого появления
+    vector<size_t> types(n, 0);
+    vector<size_t> renumeration(first.size(), 0);
+    size_t types_number = 0;
+    for (size_t s = 0; s < n; ++s) {
+        if (renumeration[block[s]] == 0) {
+            renumeration[block[s]] = ++types_number;
+        }
+        types[s] = renumeration[block[s]];
+    }
+    return types;
+}
+
+vector<size_t> Automaton::_moore_types(bool print_log, std::ostream& stream) {
     vector<string> minimizing_log;
 
     map<_MinState, int> used;
-    vector<size_t> type_mask(alphabet.size());
+    vector<size_t> type_mask(alphabet.size() + 1);
     vector<size_t> previous_types, current_types;
 
+    size_t accept_class_number;
+    current_types = _accept_classes(accept_class_number);
     for (const auto& st:states) {
-        current_types.push_back(st.get_is_accept());
-        previous_types.push_back(0);
+        // такого типа не бывает, поэтому хотя бы один раунд выполнится и типы станут нумероваться с единицы:
+        // без принимающих состояний разбиение из одних нулей иначе выбросило бы все состояния
+        previous_types.push_back(SIZE_MAX);
         minimizing_log.push_back(st.get_name() + " & " + std::to_string(st.get_is_accept()));
     }
     string format = "|c|c|";
@@ -439,6 +1186,9 @@ void Automaton::minimize(bool print_log, std::ostream& stream) {
 
     size_t types_number = 1;
     while (current_types != previous_types) {
+        if (stats) {
+            ++stats->refinement_rounds;
+        }
         std::swap(previous_types, current_types);
         for (const auto& letter : alphabet) {
             format += "c|";
@@ -448,6 +1198,7 @@ void Automaton::minimize(bool print_log, std::ostream& stream) {
         header += "& type ";
         for (size_t current_state = 0; current_state < states.size(); ++current_state) {
             int cnt = 0;
+            type_mask[cnt++] = previous_types[current_state]; // класс самого состояния тоже различает
             for (const auto& transition: transitions[current_state]) {
                 type_mask[cnt++] = previous_types[transition.get_finish()];
                 minimizing_log[current_state] += "& " + std::to_string(previous_types[transition.get_finish()]) + " ";
@@ -463,36 +1214,306 @@ void Automaton::minimize(bool print_log, std::ostream& stream) {
         used.clear();
         types_number = 1;
     }
+
+    if (print_log) {
+        stream << "LaTeX code for table of building minimum complete DFA \n \n";
+        stream << "\\begin{tabular} {" + format + "} \n"
+                  " \\hline\n";
+        stream << header << "\\\\ \n";
+        for (const auto& s: minimizing_log) {
+            stream << s << "\\\\ \n";
+        }
+        stream << std::endl;
+    }
+    return current_types;
+}
+
+// Класс состояния для начального разбиения при минимизации: 0 - не принимающее, принимающие
+// нумеруются с единицы по наборам номеров шаблонов (состояния без номеров - тоже один набор)
+vector<size_t> Automaton::_accept_classes(size_t& class_number) const {
+    map<vector<size_t>, size_t> classes;
+    vector<size_t> result(states.size(), 0);
+    for (size_t i = 0; i < states.size(); ++i) {
+        if (states[i].get_is_accept()) {
+            result[i] = classes.emplace(states[i].get_accept_ids(), classes.size() + 1).first->second;
+        }
+    }
+    class_number = classes.size() + 1;
+    return result;
+}
+
+void Automaton::_merge_states_by_types(const vector<size_t>& types) {
     vector<set<Transition>> old_transitions;
     vector<State> old_states;
-
     swap(old_states, states);
     state_number = 0;
     swap(old_transitions, transitions);
     transition_number = 0;
 
+    // тип 0 - состояние выбрасывается вместе с переходами в него; типы нумеруются в порядке первого появления
+    vector<vector<size_t>> members;
     for (size_t i = 0; i < old_states.size(); ++i) {
-        if (current_types[i] > state_number) {
-            _add_state(old_states[i].get_name(), old_states[i].get_is_start(), old_states[i].get_is_accept());
-            for (const auto& transition: old_transitions[i]) {
-                _add_transition(state_number - 1, current_types[transition.get_finish()] - 1, transition.get_expr());
-            }
+        if (types[i] == 0) {
+            continue;
+        }
+        if (types[i] > members.size()) {
+            members.emplace_back();
+        }
+        members[types[i] - 1].push_back(i);
+    }
+    for (auto& same_type: members) {
+        size_t representative = same_type[0];
+        if (same_type.size() == 1) {
+            _add_state(std::move(old_states[representative]));
         } else {
-            states[current_types[i] - 1] += old_states[i];
+            // номера шаблонов у состояний одного типа совпадают: с них начинается разбиение
+            bool is_start = false, is_accept = false;
+            for (const size_t& i: same_type) {
+                is_start |= old_states[i].get_is_start();
+                is_accept |= old_states[i].get_is_accept();
+            }
+            State merged(old_states, same_type, "+", is_start, is_accept);
+            if (!old_states[representative].get_accept_ids().empty()) {
+                merged.add_accept_ids(old_states[representative].get_accept_ids());
+            }
+            _add_state(std::move(merged));
         }
+        for (const auto& transition: old_transitions[representative]) {
+            if (types[transition.get_finish()] != 0) {
+                _add_transition(state_number - 1, types[transition.get_finish()] - 1, transition.get_expr());
+            }
+        }
+    }
+    // без стартового состояния его нет и после склейки
+    if (start_state < old_states.size() && types[start_state] != 0) {
+        start_state = types[start_state] - 1;
+    } else {
+        start_state = UINT32_MAX;
     }
+}
 
-    if (!print_log) {
-        return;
+// Разбиение множества {0, ..., size - 1} на блоки с пометкой элементов (Valmari, Lehtinen, 2008).
+// Блок b - отрезок [first[b], past[b]) массива elements, помеченные элементы блока лежат в его начале
+class _RefinablePartition{
+public:
+    size_t set_number;
+    vector<size_t> elements, location, set_of, first, past;
+
+private:
+    vector<size_t>& marked;
+    vector<size_t>& touched;
+
+public:
+    _RefinablePartition(const size_t& size, vector<size_t>& marked, vector<size_t>& touched):
+            set_number(size != 0), elements(size), location(size), set_of(size, 0),
+            first(size + 1, 0), past(size + 1, 0), marked(marked), touched(touched) {
+        for (size_t i = 0; i < size; ++i) {
+            elements[i] = location[i] = i;
+        }
+        past[0] = size;
     }
-    stream << "LaTeX code for table of building minimum complete DFA \n \n";
-    stream << "\\begin{tabular} {" + format + "} \n"
-              " \\hline\n";
-    stream << header << "\\\\ \n";
-    for (const auto& s: minimizing_log) {
-        stream << s << "\\\\ \n";
+
+    void mark(const size_t& element) {
+        size_t s = set_of[element];
+        size_t i = location[element];
+        size_t j = first[s] + marked[s];
+        elements[i] = elements[j];
+        location[elements[i]] = i;
+        elements[j] = element;
+        location[element] = j;
+        if (marked[s]++ == 0) {
+            touched.push_back(s);
+        }
+    }
+
+    // каждый затронутый блок делится на помеченную и непомеченную части, меньшая получает новый номер
+    void split() {
+        while (!touched.empty()) {
+            size_t s = touched.back();
+            touched.pop_back();
+            size_t j = first[s] + marked[s];
+            if (j == past[s]) {
+                marked[s] = 0;
+                continue;
+            }
+            if (marked[s] <= past[s] - j) {
+                first[set_number] = first[s];
+                past[set_number] = first[s] = j;
+            } else {
+                past[set_number] = past[s];
+                first[set_number] = past[s] = j;
+            }
+            for (size_t i = first[set_number]; i < past[set_number]; ++i) {
+                set_of[elements[i]] = set_number;
+            }
+            marked[s] = marked[set_number++] = 0;
+        }
+    }
+};
+
+// Минимизация частичного ДКА без стока: работает по настоящим переходам, состояния, которые
+// недостижимы или из которых нельзя попасть в принимающее, выбрасываются (тип 0)
+vector<size_t> Automaton::_valmari_types() const {
+    const size_t n = states.size();
+    vector<size_t> tail, label, head;
+    for (size_t s = 0; s < n; ++s) {
+        for (const auto& transition: transitions[s]) {
+            tail.push_back(s);
+            label.push_back(letter_id[static_cast<unsigned char>(transition.get_expr()[0])]);
+            head.push_back(transition.get_finish());
+        }
+    }
+    size_t m = tail.size();
+
+    vector<size_t> marked(std::max(n, m) + 1, 0), touched;
+    _RefinablePartition blocks(n, marked, touched);
+    vector<size_t> adjacent(m), adjacent_start(n + 1);
+    auto make_adjacent = [&](const vector<size_t>& key) {
+        std::fill(adjacent_start.begin(), adjacent_start.end(), 0);
+        for (size_t t = 0; t < m; ++t) {
+            ++adjacent_start[key[t]];
+        }
+        for (size_t q = 0; q < n; ++q) {
+            adjacent_start[q + 1] += adjacent_start[q];
+        }
+        for (size_t t = m; t-- > 0;) {
+            adjacent[--adjacent_start[key[t]]] = t;
+        }
+    };
+
+    // достигнутые состояния собираются в начале blocks.elements
+    size_t reached = 0;
+    auto reach = [&](const size_t& q) {
+        size_t i = blocks.location[q];
+        if (i >= reached) {
+            blocks.elements[i] = blocks.elements[reached];
+            blocks.location[blocks.elements[i]] = i;
+            blocks.elements[reached] = q;
+            blocks.location[q] = reached++;
+        }
+    };
+    auto remove_unreachable = [&](vector<size_t>& from, vector<size_t>& to) {
+        make_adjacent(from);
+        for (size_t i = 0; i < reached; ++i) {
+            size_t q = blocks.elements[i];
+            for (size_t j = adjacent_start[q]; j < adjacent_start[q + 1]; ++j) {
+                reach(to[adjacent[j]]);
+            }
+        }
+        size_t kept = 0;
+        for (size_t t = 0; t < m; ++t) {
+            if (blocks.location[from[t]] < reached) {
+                head[kept] = head[t];
+                label[kept] = label[t];
+                tail[kept] = tail[t];
+                ++kept;
+            }
+        }
+        m = kept;
+        blocks.past[0] = reached;
+        reached = 0;
+    };
+
+    vector<size_t> types(n, 0);
+    if (start_state >= n) {
+        return types;
+    }
+    reach(start_state);
+    remove_unreachable(tail, head);
+    for (size_t q = 0; q < n; ++q) {
+        if (states[q].get_is_accept() && blocks.location[q] < blocks.past[0]) {
+            reach(q);
+        }
+    }
+    size_t accept_number = reached;
+    remove_unreachable(head, tail);
+    const size_t kept_number = blocks.past[0];  // состояния на позициях дальше выброшены и больше не двигаются
+    if (blocks.location[start_state] >= kept_number) {
+        types[start_state] = 1;  // язык пуст: остаётся одно стартовое состояние без переходов
+        return types;
+    }
+
+    // принимающие состояния стоят в начале единственного блока - отделяем их, а затем делим по наборам номеров шаблонов
+    marked[0] = accept_number;
+    if (accept_number) {
+        touched.push_back(0);
+        blocks.split();
+    }
+    size_t accept_class_number;
+    vector<size_t> accept_class = _accept_classes(accept_class_number);
+    if (accept_class_number > 2) {
+        vector<vector<size_t>> by_class(accept_class_number);
+        for (size_t q = 0; q < n; ++q) {
+            if (accept_class[q] > 1 && blocks.location[q] < kept_number) {
+                by_class[accept_class[q]].push_back(q);
+            }
+        }
+        for (const auto& same_class: by_class) {
+            for (const size_t& q: same_class) {
+                blocks.mark(q);
+            }
+            blocks.split();
+        }
+    }
+
+    // разбиение переходов по буквам
+    _RefinablePartition cords(m, marked, touched);
+    if (m) {
+        std::sort(cords.elements.begin(), cords.elements.begin() + m,
+                  [&](const size_t& i, const size_t& j) { return label[i] < label[j]; });
+        cords.set_number = marked[0] = 0;
+        size_t letter = label[cords.elements[0]];
+        for (size_t i = 0; i < m; ++i) {
+            size_t t = cords.elements[i];
+            if (label[t] != letter) {
+                letter = label[t];
+                cords.past[cords.set_number++] = i;
+                cords.first[cords.set_number] = i;
+                marked[cords.set_number] = 0;
+            }
+            cords.set_of[t] = cords.set_number;
+            cords.location[t] = i;
+        }
+        cords.past[cords.set_number++] = m;
+    }
+
+    make_adjacent(head);
+    size_t b = 1, c = 0;
+    while (c < cords.set_number) {
+        for (size_t i = cords.first[c]; i < cords.past[c]; ++i) {
+            blocks.mark(tail[cords.elements[i]]);
+        }
+        blocks.split();
+        ++c;
+        while (b < blocks.set_number) {
+            for (size_t i = blocks.first[b]; i < blocks.past[b]; ++i) {
+                size_t q = blocks.elements[i];
+                for (size_t j = adjacent_start[q]; j < adjacent_start[q + 1]; ++j) {
+                    cords.mark(adjacent[j]);
+                }
+            }
+            cords.split();
+            ++b;
+        }
     }
-    stream << std::endl;
+    if (stats) {
+        stats->refinement_rounds += c;
+    }
+
+    // нумеруем блоки с единицы в порядке первого появления, выброшенные состояния остаются с типом 0
+    vector<size_t> renumeration(blocks.set_number, 0);
+    size_t types_number = 0;
+    for (size_t q = 0; q < n; ++q) {
+        if (blocks.location[q] >= kept_number) {
+            continue;
+        }
+        size_t block = blocks.set_of[q];
+        if (renumeration[block] == 0) {
+            renumeration[block] = ++types_number;
+        }
+        types[q] = renumeration[block];
+    }
+    return types;
 }
 
 void Automaton::complete() {
@@ -500,6 +1521,7 @@ void Automaton::complete() {
         return;
     }
     is_complete = true;
+    _PhaseTimer timer(stats ? &stats->completion_seconds : nullptr);
     bool complete = true;
     for (const auto& state_transitions: transitions) {
         if (state_transitions.size() != alphabet.size()) {
@@ -511,18 +1533,50 @@ void Automaton::complete() {
     }
 
     _add_state("drain", false, false);
+    vector<bool> has_letter(letters.size());
     for (size_t i = 0; i < state_number; ++i) {
-        for (const auto& letter: alphabet) {
-            if (!_is_exist_transition_by_letter(i, letter)) {
-                _add_transition(i, state_number - 1, letter);
+        std::fill(has_letter.begin(), has_letter.end(), false);
+        for (const auto& transition: transitions[i]) {
+            has_letter[letter_id[static_cast<unsigned char>(transition.get_expr()[0])]] = true;
+        }
+        for (size_t letter = 0; letter < letters.size(); ++letter) {
+            if (!has_letter[letter]) {
+                _add_transition(i, state_number - 1, letters[letter]);
             }
         }
     }
 }
 
-bool Automaton::_is_exist_transition_by_letter(const int& start, const string& expr) {
-    const auto& transition = transitions[start].lower_bound(Transition(expr, 0));
-    return transition->get_expr() == expr;
+void Automaton::use_letter_classes(bool enabled) {
+    merge_letters = enabled;
+}
+
+void Automaton::set_stats(AutomatonStats* collected_stats) {
+    stats = collected_stats;
+}
+
+// Буквы a и b попадают в один класс, если из каждого состояния по ним одни и те же переходы.
+// Считается только для автомата с однобуквенными переходами
+void Automaton::_build_letter_classes() {
+    for (size_t letter = 0; letter < letters.size(); ++letter) {
+        letter_class[letter] = letter;
+    }
+    if (!merge_letters) {
+        return;
+    }
+    vector<vector<pair<size_t, size_t>>> behaviour(letters.size());
+    for (size_t i = 0; i < transitions.size(); ++i) {
+        for (const auto& transition: transitions[i]) {
+            if (transition.get_expr().size() != 1) {
+                continue;
+            }
+            behaviour[letter_id[static_cast<unsigned char>(transition.get_expr()[0])]].emplace_back(i, transition.get_finish());
+        }
+    }
+    map<vector<pair<size_t, size_t>>, size_t> representative;
+    for (size_t letter = 0; letter < letters.size(); ++letter) {
+        letter_class[letter] = representative.emplace(std::move(behaviour[letter]), letter).first->second;
+    }
 }
 
 void Automaton::_add_transition(const size_t& start, const size_t& finish, const string& expr) {
@@ -540,7 +1594,11 @@ void Automaton::_delete_transition(const size_t& start, const Transition& transi
 }
 
 void Automaton::_add_state(const string& name, const bool& is_start, const bool& is_accept) {
-    states.emplace_back(name, is_start, is_accept);
+    _add_state(State(name, is_start, is_accept));
+}
+
+void Automaton::_add_state(State state) {
+    states.push_back(std::move(state));
     transitions.emplace_back();
     ++state_number;
 }
@@ -549,9 +1607,18 @@ void Automaton::make_one_letter() {
     if (is_one_letter) {
         return;
     }
-    _make_leq_one_letter();
-    _remove_epsilon_transitions();
+    {
+        _PhaseTimer timer(stats ? &stats->letter_splitting_seconds : nullptr);
+        _make_leq_one_letter();
+    }
+    {
+        _PhaseTimer timer(stats ? &stats->epsilon_removal_seconds : nullptr);
+        _remove_epsilon_transitions();
+    }
     is_one_letter = true;
+    if (stats) {
+        stats->update_peak_memory();
+    }
 }
 
 size_t Automaton::get_state_number() {
@@ -560,4 +1627,35 @@ size_t Automaton::get_state_number() {
 
 size_t Automaton::get_transition_number() {
     return transition_number;
+}
+
+const vector<State>& Automaton::get_states() const {
+    return states;
+}
+
+const vector<set<Transition>>& Automaton::get_transitions() const {
+    return transitions;
+}
+
+const set<string>& Automaton::get_alphabet() const {
+    return alphabet;
+}
+
+const size_t& Automaton::get_start_state() const {
+    return start_state;
+}
+
+const vector<string>& Automaton::get_letters() const {
+    return letters;
+}
+
+size_t Automaton::get_letter_id(const string& letter) const {
+    if (letter.size() != 1) {
+        return NO_LETTER;
+    }
+    return letter_id[static_cast<unsigned char>(letter[0])];
+}
+
+const vector<size_t>& Automaton::get_letter_classes() const {
+    return letter_class;
 }
\ No newline at end of file
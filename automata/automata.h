@@ -6,14 +6,19 @@
 #define AUTOMATA_AUTOMATA_H
 
 #include <iostream>
+#include <array>
 #include <utility>
 #include <vector>
 #include <algorithm>
 #include <string>
+#include <string_view>
 #include <set>
 #include <map>
+#include <memory>
+#include <unordered_map>
 #include <queue>
 #include <exception>
+#include <cstdint>
 
 
 using std::vector;
@@ -23,41 +28,66 @@ using std::set;
 using std::queue;
 using std::map;
 
+class ThreadPool;
+struct AutomatonStats;
 
-class too_many_states_exception: std::exception{
+
+class too_many_start_states_exception: std::exception{
     [[nodiscard]] const char* what() const noexcept override;
 };
 
-class too_many_start_states_exception: std::exception{
+class not_deterministic_exception: std::exception{
     [[nodiscard]] const char* what() const noexcept override;
 };
 
 
 class State{
+    // Имя хранится деревом: лист - имя, данное при создании, у производного состояния - узлы имён
+    // состояний, из которых оно получено, и get_name() склеивает их через separator. Преобразования
+    // только копируют указатели на узлы: строки собираются при чтении имени, а узел держит только
+    // имена своих источников, а не весь прежний вектор состояний
+    struct _Provenance{
+        string name;
+        vector<std::shared_ptr<const _Provenance>> parts;
+        const char* separator;
+    };
+
+    std::shared_ptr<const _Provenance> provenance;
+    vector<size_t> accept_ids;  // номера шаблонов, которые принимает состояние, по возрастанию (см. pattern_union)
+
 public:
-    string name;
     bool is_start;
     bool is_accept;
 
 public:
     State() = delete;
     State(string  name, const bool& is_start, const bool& is_accept):
-        name(std::move(name)),
+        provenance(std::make_shared<const _Provenance>(_Provenance{std::move(name), {}, ""})),
         is_start(is_start),
         is_accept(is_accept) {
     }
+    // состояние, полученное из состояний source с номерами ids
+    State(const vector<State>& source, const vector<size_t>& ids, const char* separator,
+          const bool& is_start, const bool& is_accept);
 
-    [[nodiscard]] const string& get_name() const;
+    // Собирает имя заново при каждом вызове и ничего не меняет, так что безопасно из нескольких потоков
+    [[nodiscard]] string get_name() const;
     [[nodiscard]] const bool& get_is_start() const;
     [[nodiscard]] const bool& get_is_accept() const;
+    [[nodiscard]] const vector<size_t>& get_accept_ids() const;
     void make_accept();
+    // добавляет номера шаблонов (по возрастанию) и делает состояние принимающим
+    void add_accept_ids(const vector<size_t>& ids);
 
     void operator+=(const State&);
+
+private:
+    static void _append_name(const _Provenance&, string&);
 };
 
 
 class _MinState{
-    string achievable;
+    vector<size_t> achievable;
 public:
     _MinState() = delete;
     explicit _MinState(const vector<size_t>&);
@@ -66,20 +96,60 @@ public:
 };
 
 
+// Множество состояний произвольного размера (по 64 состояния на слово)
+class _Bitset{
+    vector<unsigned long long> words;
+
+public:
+    _Bitset() = default;
+    explicit _Bitset(const size_t& size);
+
+    void set(const size_t&);
+    void clear();
+    [[nodiscard]] bool test(const size_t&) const;
+    [[nodiscard]] bool none() const;
+    [[nodiscard]] size_t count() const;
+    [[nodiscard]] const vector<unsigned long long>& get_words() const;
+
+    // вызывает f(i) для каждого установленного бита i по возрастанию
+    template<typename Function>
+    void for_each(Function&& f) const {
+        for (size_t w = 0; w < words.size(); ++w) {
+            unsigned long long word = words[w];
+            while (word) {
+                f(w * 64 + __builtin_ctzll(word));
+                word &= word - 1;
+            }
+        }
+    }
+
+    bool operator==(const _Bitset&) const;
+    bool operator!=(const _Bitset&) const;
+    _Bitset& operator|=(const _Bitset&);
+};
+
+struct _BitsetHash{
+    size_t operator()(const _Bitset&) const;
+};
+
+
 class _DetState{
-    unsigned long long mask;
+    _Bitset mask;
     bool is_start;
     bool is_accept;
 
 public:
-    _DetState();
-    _DetState(const unsigned long long&, const bool&, const bool&);
+    _DetState() = delete;
+    explicit _DetState(const size_t& size);
+    _DetState(_Bitset, const bool&, const bool&);
 
-    [[nodiscard]] const unsigned long long& get_mask() const;
+    [[nodiscard]] const _Bitset& get_mask() const;
     [[nodiscard]] const bool& get_is_start() const;
     [[nodiscard]] const bool& get_is_accept() const;
 
-    bool operator<(const _DetState&) const;
+    void add(const size_t& state, const bool& accept);
+
+    bool operator==(const _DetState&) const;
 
     _DetState operator|(const _DetState&) const;
     _DetState& operator|=(const _DetState&);
@@ -99,10 +169,40 @@ public:
 };
 
 
+// Указатель на статистику из Automaton::set_stats. Не владеет и не копируется вместе с автоматом:
+// копии, которые библиотека делает для своей работы (CompiledAutomaton::determinized, is_included),
+// не пишут в статистику вызывающего
+class _StatsPointer{
+    AutomatonStats* pointer = nullptr;
+
+public:
+    _StatsPointer() = default;
+    _StatsPointer(const _StatsPointer&) {}
+    _StatsPointer& operator=(const _StatsPointer&) {
+        return *this;
+    }
+    _StatsPointer& operator=(AutomatonStats* stats) {
+        pointer = stats;
+        return *this;
+    }
+
+    operator AutomatonStats*() const {
+        return pointer;
+    }
+    AutomatonStats* operator->() const {
+        return pointer;
+    }
+};
+
+
 class Automaton{
     vector<State> states;
     vector<set<Transition>> transitions;
     set<string> alphabet;
+    vector<string> letters;                 // буквы алфавита по порядку, номер буквы - индекс в этом векторе
+    std::array<size_t, 256> letter_id{};    // номер буквы по её байту, NO_LETTER - байт не из алфавита
+    vector<size_t> letter_class;            // номер буквы-представителя класса одинаково ведущих себя букв
+    bool merge_letters = false;
     size_t state_number;
     size_t transition_number;
     size_t start_state = UINT32_MAX;
@@ -110,41 +210,74 @@ class Automaton{
     bool is_DFA = false;
     bool is_complete = false;
     bool is_minimum = false;
-
-    static const size_t MAX_AUTOMATA_SIZE = 60;
+    _StatsPointer stats;
 
 public:
+    static constexpr size_t NO_LETTER = SIZE_MAX;  // get_letter_id для буквы не из алфавита
+
     Automaton() = delete;
     Automaton(const vector<State>&, const vector<set<Transition>>&);
 
     friend std::ostream& operator<<(std::ostream & stream, const Automaton& automaton);
+    friend class DictionaryBuilder;
+    friend class ProductAutomaton;
 
     void determinize();
+    void determinize(ThreadPool& pool);
+    [[nodiscard]] bool accepts(std::string_view word) const;
     void output_alphabet(std::ostream&) const ;
     void output_states(std::ostream&) const ;
     void output_transitions(std::ostream&) const ;
     void minimize(bool print_log=false, std::ostream& stream=std::cout);
+    void minimize_partial();
     void complete();
     void tex_graph_print(std::ostream & stream) const ;
     void tex_transition_table_print(std::ostream & stream) const ;
+    // C++-код функции bool function_name(std::string_view) для ДКА с однобуквенными переходами:
+    // состояния - метки, переходы - switch и goto; с tables - constexpr-таблица next[state][byte]
+    void cpp_matcher_print(std::ostream & stream, const string& function_name, bool tables = false) const ;
     void make_one_letter();
+    void use_letter_classes(bool enabled = true);
+    // Статистика собирается только для этого объекта: копии автомата начинают без неё
+    void set_stats(AutomatonStats* collected_stats);
     size_t get_state_number();
     size_t get_transition_number();
 
+    [[nodiscard]] const vector<State>& get_states() const;
+    [[nodiscard]] const vector<set<Transition>>& get_transitions() const;
+    [[nodiscard]] const set<string>& get_alphabet() const;
+    [[nodiscard]] const vector<string>& get_letters() const;
+    // NO_LETTER, если такой буквы нет в алфавите
+    [[nodiscard]] size_t get_letter_id(const string& letter) const;
+    [[nodiscard]] const vector<size_t>& get_letter_classes() const;
+    [[nodiscard]] const size_t& get_start_state() const;
+
 private:
+    static Automaton _from_dfa(const vector<State>&, const vector<set<Transition>>&);
     void _add_transition(const size_t&, const size_t&, const string&);
     void _delete_transition(const size_t&, const Transition&);
     void _add_state(const string&, const bool&, const bool&);
-    bool _is_exist_transition_by_letter(const int &start, const string &expr);
+    void _add_state(State state);
+    void _build_letter_classes();
 
     void _make_leq_one_letter();
     void _remove_epsilon_transitions();
-    void _push_epsilon_transitions_in_state(const size_t&, const vector<set<Transition>>&);
+    [[nodiscard]] vector<size_t> _epsilon_components(size_t& component_number) const;
     void _classify();
+    void _classify_parallel(ThreadPool& pool);
+    [[nodiscard]] vector<vector<pair<size_t, size_t>>> _transitions_by_class_letter() const;
+    [[nodiscard]] vector<vector<size_t>> _class_letters() const;
+    [[nodiscard]] vector<size_t> _hopcroft_types() const;
+    [[nodiscard]] vector<size_t> _valmari_types() const;
+    [[nodiscard]] vector<size_t> _accept_classes(size_t& class_number) const;
+    vector<size_t> _moore_types(bool print_log, std::ostream& stream);
+    void _merge_states_by_types(const vector<size_t>& types);
     void _recalc_state_number();
     void _recalc_transition_number();
 
-    string _build_name_by_mask(const unsigned long long& mask, const vector<State>& old_states, const string& separator = "");
+    // Перед тем как состояния станут источником имён новых: их собственные источники больше не нужны
+    static State _subset_state(const vector<State>& source, const _Bitset& mask,
+                               const bool& is_start, const bool& is_accept);
 };
 
 #endif //AUTOMATA_AUTOMATA_H
@@ -0,0 +1,22 @@
+#include "automaton_stats.h"
+
+#include <sys/resource.h>
+
+void AutomatonStats::update_peak_memory() {
+    rusage usage{};
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        peak_memory_kb = static_cast<size_t>(usage.ru_maxrss);
+    }
+}
+
+std::ostream& operator<<(std::ostream& stream, const AutomatonStats& stats) {
+    stream << "letter splitting: " << stats.letter_splitting_seconds << " s\n"
+           << "epsilon removal: " << stats.epsilon_removal_seconds << " s\n"
+           << "subset construction: " << stats.subset_construction_seconds << " s\n"
+           << "completion: " << stats.completion_seconds << " s\n"
+           << "refinement: " << stats.refinement_seconds << " s, " << stats.refinement_rounds << " rounds\n"
+           << "subset states: " << stats.subset_states_created << " created, "
+           << stats.duplicate_subsets << " duplicates, " << stats.map_lookups << " lookups\n"
+           << "peak memory: " << stats.peak_memory_kb << " KiB\n";
+    return stream;
+}
@@ -0,0 +1,28 @@
+#ifndef AUTOMATA_AUTOMATON_STATS_H
+#define AUTOMATA_AUTOMATON_STATS_H
+
+#include <cstddef>
+#include <ostream>
+
+
+// Статистика преобразований автомата. Собирается, только если передана в Automaton::set_stats,
+// иначе проверяется лишь указатель в начале и конце каждой фазы. Значения накапливаются между вызовами
+struct AutomatonStats{
+    double letter_splitting_seconds = 0;
+    double epsilon_removal_seconds = 0;
+    double subset_construction_seconds = 0;
+    double completion_seconds = 0;
+    double refinement_seconds = 0;
+
+    size_t refinement_rounds = 0;       // сплиттеры Хопкрофта и Valmari-Lehtinen или раунды Мура
+    size_t subset_states_created = 0;
+    size_t duplicate_subsets = 0;       // подмножество получено повторно; в очередь оно не попадает
+    size_t map_lookups = 0;             // обращения к таблице подмножеств
+    size_t peak_memory_kb = 0;          // максимальный размер резидентной памяти процесса
+
+    void update_peak_memory();
+
+    friend std::ostream& operator<<(std::ostream& stream, const AutomatonStats& stats);
+};
+
+#endif //AUTOMATA_AUTOMATON_STATS_H
@@ -0,0 +1,382 @@
+#include "benchmark/benchmark.h"
+#include "automata.h"
+#include "compiled_automaton.h"
+#include "lazy_automaton.h"
+#include "bit_parallel_matcher.h"
+#include "thread_pool.h"
+#include "multi_pattern.h"
+#include "generated_matcher.h"
+#include <algorithm>
+#include <random>
+
+
+// Случайный полный ДКА над буквами 'a'..'a' + letter_number - 1
+static Automaton random_dfa(size_t state_number, size_t letter_number, unsigned seed) {
+    std::mt19937 rng(seed);
+    vector<State> st;
+    vector<set<Transition>> tr(state_number);
+    for (size_t i = 0; i < state_number; ++i) {
+        st.emplace_back(std::to_string(i), i == 0, rng() % 2);
+        for (size_t letter = 0; letter < letter_number; ++letter) {
+            tr[i].insert(Transition(string(1, char('a' + letter)), rng() % state_number));
+        }
+    }
+    return Automaton(st, tr);
+}
+
+static vector<string> random_words(size_t word_number, size_t letter_number, size_t max_length, unsigned seed) {
+    std::mt19937 rng(seed);
+    vector<string> words(word_number);
+    for (auto& word: words) {
+        word.resize(1 + rng() % max_length);
+        for (auto& c: word) {
+            c = char('a' + rng() % letter_number);
+        }
+    }
+    return words;
+}
+
+// Семейства входов для этапов построения. Случайный НКА: range(0) состояний, в среднем range(1) / 4 переходов
+// из состояния по буквам a, b и пустому слову
+static Automaton random_nfa(int64_t state_number, int64_t density) {
+    std::mt19937 rng(3);
+    vector<State> st;
+    vector<set<Transition>> tr(state_number);
+    const string labels[] = {"a", "b", ""};
+    for (int64_t i = 0; i < state_number; ++i) {
+        st.emplace_back(std::to_string(i), i == 0, rng() % 4 == 0);
+        for (int64_t j = 0; j < density; j += 4) {
+            tr[i].insert(Transition(labels[rng() % 3], rng() % state_number));
+        }
+    }
+    return Automaton(st, tr);
+}
+
+// (a|b)*a(a|b)^n: минимальный ДКА для него имеет 2^(n+1) состояний
+static Automaton nth_letter_from_end(int64_t n) {
+    vector<State> st;
+    vector<set<Transition>> tr(n + 2);
+    for (int64_t i = 0; i < n + 2; ++i) {
+        st.emplace_back(std::to_string(i), i == 0, i == n + 1);
+    }
+    tr[0] = {Transition("a", 0), Transition("b", 0), Transition("a", 1)};
+    for (int64_t i = 1; i <= n; ++i) {
+        tr[i] = {Transition("a", i + 1), Transition("b", i + 1)};
+    }
+    return Automaton(st, tr);
+}
+
+// Цепочка из range(0) состояний, на каждом по две метки длины range(1) вперёд и одна назад
+static Automaton long_labels(int64_t state_number, int64_t label_length) {
+    std::mt19937 rng(4);
+    vector<State> st;
+    vector<set<Transition>> tr(state_number);
+    auto label = [&]() {
+        string result(label_length, 'a');
+        for (auto& c: result) {
+            c = char('a' + rng() % 4);
+        }
+        return result;
+    };
+    for (int64_t i = 0; i < state_number; ++i) {
+        st.emplace_back(std::to_string(i), i == 0, i == state_number - 1);
+        tr[i].insert(Transition(label(), (i + 1) % state_number));
+        tr[i].insert(Transition(label(), (i + 1) % state_number));
+        tr[i].insert(Transition(label(), rng() % (i + 1)));
+    }
+    return Automaton(st, tr);
+}
+
+// Этапы конвейера по порядку: каждый бенчмарк заранее применяет предыдущие этапы и меряет только свой
+enum Phase {
+    MAKE_ONE_LETTER,
+    DETERMINIZE,
+    COMPLETE,
+    MINIMIZE
+};
+
+static void apply_phase(Automaton& automaton, Phase phase) {
+    switch (phase) {
+        case MAKE_ONE_LETTER: automaton.make_one_letter(); break;
+        case DETERMINIZE: automaton.determinize(); break;
+        case COMPLETE: automaton.complete(); break;
+        case MINIMIZE: automaton.minimize(); break;
+    }
+}
+
+// Вход BM_Phase по аргументам бенчмарка: у каждого семейства свои аргументы
+static Automaton random_nfa_input(const benchmark::State& state) {
+    return random_nfa(state.range(0), state.range(1));
+}
+
+static Automaton nth_letter_from_end_input(const benchmark::State& state) {
+    return nth_letter_from_end(state.range(0));
+}
+
+static Automaton long_labels_input(const benchmark::State& state) {
+    return long_labels(state.range(0), state.range(1));
+}
+
+template <class Generator>
+static void BM_Phase(benchmark::State& state, Phase phase, Generator generator) {
+    Automaton prepared = generator(state);
+    for (int previous = MAKE_ONE_LETTER; previous < phase; ++previous) {
+        apply_phase(prepared, Phase(previous));
+    }
+    for (auto _: state) {
+        state.PauseTiming();
+        Automaton automaton = prepared;
+        state.ResumeTiming();
+        apply_phase(automaton, phase);
+        benchmark::DoNotOptimize(automaton.get_states().data());
+    }
+    Automaton result = prepared;
+    apply_phase(result, phase);
+    state.counters["states_in"] = prepared.get_states().size();
+    state.counters["states_out"] = result.get_states().size();
+}
+
+static void random_nfa_args(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgsProduct({{16, 24}, {4, 8, 16}});
+}
+
+static void nth_letter_from_end_args(benchmark::internal::Benchmark* benchmark) {
+    benchmark->DenseRange(4, 16, 4)->ArgName("n");
+}
+
+static void long_labels_args(benchmark::internal::Benchmark* benchmark) {
+    benchmark->ArgsProduct({{200, 1000}, {8, 32}});
+}
+
+#define PHASE_BENCHMARKS(phase)                                                                        \
+    BENCHMARK_CAPTURE(BM_Phase, phase##_random_nfa, phase, random_nfa_input)                           \
+        ->Apply(random_nfa_args)->Unit(benchmark::kMicrosecond);                                       \
+    BENCHMARK_CAPTURE(BM_Phase, phase##_nth_letter_from_end, phase, nth_letter_from_end_input)         \
+        ->Apply(nth_letter_from_end_args)->Unit(benchmark::kMicrosecond);                              \
+    BENCHMARK_CAPTURE(BM_Phase, phase##_long_labels, phase, long_labels_input)                         \
+        ->Apply(long_labels_args)->Unit(benchmark::kMicrosecond)
+
+PHASE_BENCHMARKS(MAKE_ONE_LETTER);
+PHASE_BENCHMARKS(DETERMINIZE);
+PHASE_BENCHMARKS(COMPLETE);
+PHASE_BENCHMARKS(MINIMIZE);
+
+
+// range(0) - число состояний ДКА, range(1) - максимальная длина слова
+static void BM_AcceptsOneByOne(benchmark::State& state) {
+    const CompiledAutomaton compiled(random_dfa(state.range(0), 16, 1));
+    auto storage = random_words(1 << 14, 16, state.range(1), 2);
+    vector<std::string_view> words(storage.begin(), storage.end());
+    size_t bytes = 0;
+    for (const auto& word: words) {
+        bytes += word.size();
+    }
+    for (auto _: state) {
+        vector<unsigned long long> result((words.size() + 63) / 64, 0);
+        for (size_t i = 0; i < words.size(); ++i) {
+            if (compiled.accepts(words[i])) {
+                result[i / 64] |= 1ull << (i % 64);
+            }
+        }
+        benchmark::DoNotOptimize(result.data());
+    }
+    state.SetBytesProcessed(state.iterations() * bytes);
+    state.SetItemsProcessed(state.iterations() * words.size());
+}
+
+static void BM_AcceptsInterleaved(benchmark::State& state) {
+    const CompiledAutomaton compiled(random_dfa(state.range(0), 16, 1));
+    auto storage = random_words(1 << 14, 16, state.range(1), 2);
+    vector<std::string_view> words(storage.begin(), storage.end());
+    size_t bytes = 0;
+    for (const auto& word: words) {
+        bytes += word.size();
+    }
+    for (auto _: state) {
+        auto result = compiled.accepts_interleaved(words);
+        benchmark::DoNotOptimize(result.data());
+    }
+    state.SetBytesProcessed(state.iterations() * bytes);
+    state.SetItemsProcessed(state.iterations() * words.size());
+}
+
+// Сборка таблицы из Automaton против загрузки уже сохранённой таблицы
+static void BM_CompileFromAutomaton(benchmark::State& state) {
+    auto automaton = random_dfa(state.range(0), 16, 1);
+    for (auto _: state) {
+        CompiledAutomaton compiled(automaton);
+        benchmark::DoNotOptimize(compiled.get_start_state());
+    }
+}
+
+static void BM_LoadMapped(benchmark::State& state) {
+    const string path = "bench_automaton.bin";
+    CompiledAutomaton(random_dfa(state.range(0), 16, 1)).save(path);
+    for (auto _: state) {
+        auto compiled = CompiledAutomaton::load(path);
+        benchmark::DoNotOptimize(compiled.accepts("abacaba"));
+    }
+    std::remove(path.c_str());
+}
+
+// НКА (a|b)*a(a|b)^n без детерминизации: битовые маски против ленивого ДКА с ограниченным кэшем
+static void BM_BitParallelAccepts(benchmark::State& state) {
+    const BitParallelMatcher matcher(nth_letter_from_end(state.range(0)));
+    auto words = random_words(1 << 10, 2, 1024, 5);
+    size_t bytes = 0;
+    for (const auto& word: words) {
+        bytes += word.size();
+    }
+    for (auto _: state) {
+        size_t accepted = 0;
+        for (const auto& word: words) {
+            accepted += matcher.accepts(word);
+        }
+        benchmark::DoNotOptimize(accepted);
+    }
+    state.SetBytesProcessed(state.iterations() * bytes);
+}
+
+static void BM_LazyAccepts(benchmark::State& state) {
+    LazyAutomaton lazy(nth_letter_from_end(state.range(0)));
+    auto words = random_words(1 << 10, 2, 1024, 5);
+    size_t bytes = 0;
+    for (const auto& word: words) {
+        bytes += word.size();
+    }
+    for (auto _: state) {
+        size_t accepted = 0;
+        for (const auto& word: words) {
+            accepted += lazy.accepts(word);
+        }
+        benchmark::DoNotOptimize(accepted);
+    }
+    state.SetBytesProcessed(state.iterations() * bytes);
+    state.counters["flushes"] = lazy.get_flush_number();
+}
+
+// Разреженный ДКА: из каждого состояния out_degree переходов по случайным буквам из letter_number
+static Automaton random_sparse_dfa(size_t state_number, size_t letter_number, size_t out_degree, unsigned seed) {
+    std::mt19937 rng(seed);
+    vector<State> st;
+    vector<set<Transition>> tr(state_number);
+    for (size_t i = 0; i < state_number; ++i) {
+        st.emplace_back(std::to_string(i), i == 0, rng() % 2);
+        set<size_t> used;
+        while (used.size() < out_degree) {
+            used.insert(rng() % letter_number);
+        }
+        for (const auto& letter: used) {
+            tr[i].insert(Transition(string(1, char('a' + letter)), rng() % state_number));
+        }
+    }
+    return Automaton(st, tr);
+}
+
+// Слова - случайные пути по переходам, чтобы они не обрывались в DEAD_STATE с первых букв
+static vector<string> random_paths(const Automaton& automaton, size_t word_number, size_t max_length, unsigned seed) {
+    std::mt19937 rng(seed);
+    vector<string> words(word_number);
+    for (auto& word: words) {
+        size_t state = automaton.get_start_state();
+        size_t length = 1 + rng() % max_length;
+        while (word.size() < length && !automaton.get_transitions()[state].empty()) {
+            auto transition = automaton.get_transitions()[state].begin();
+            std::advance(transition, rng() % automaton.get_transitions()[state].size());
+            word += transition->get_expr();
+            state = transition->get_finish();
+        }
+    }
+    return words;
+}
+
+// range(0) - число состояний, range(1) - 0 для плотной таблицы и 1 для упакованной; table_bytes - память под переходы
+static void BM_TableLayout(benchmark::State& state) {
+    Automaton automaton = random_sparse_dfa(state.range(0), 64, 2, 6);
+    const CompiledAutomaton compiled(automaton, state.range(1) ? TableLayout::row_displacement : TableLayout::dense);
+    auto storage = random_paths(automaton, 1 << 14, 256, 7);
+    vector<std::string_view> words(storage.begin(), storage.end());
+    size_t bytes = 0;
+    for (const auto& word: words) {
+        bytes += word.size();
+    }
+    for (auto _: state) {
+        auto result = compiled.accepts_interleaved(words);
+        benchmark::DoNotOptimize(result.data());
+    }
+    state.SetBytesProcessed(state.iterations() * bytes);
+    state.counters["table_bytes"] = compiled.get_table_bytes();
+}
+
+// Поиск слов из keyword_search_patterns (см. CMakeLists.txt) в тексте из 16 МБ из их букв:
+// range(0) = 0 - таблица CompiledAutomaton, 1 - сгенерированный codegen switch/goto, 2 - сгенерированные таблицы
+static void BM_GeneratedMatcher(benchmark::State& state) {
+    vector<Automaton> patterns;
+    string letters;
+    for (const string word: keyword_search_patterns) {
+        vector<State> st = {State("0", true, false), State("1", false, true)};
+        vector<set<Transition>> tr {{Transition(word, 1)}, {}};
+        patterns.emplace_back(st, tr);
+        letters += word;
+    }
+    Automaton automaton = pattern_union(patterns, true);
+    automaton.determinize();
+    automaton.minimize();
+    const CompiledAutomaton compiled(automaton);
+    std::mt19937 rng(25);
+    vector<string> texts(16);
+    for (auto& text: texts) {
+        text.resize(1 << 20);
+        for (auto& c: text) {
+            c = letters[rng() % letters.size()];
+        }
+        if (compiled.accepts(text) != keyword_search(text) || compiled.accepts(text) != keyword_search_tables(text)) {
+            state.SkipWithError("generated matcher disagrees with the compiled automaton");
+            return;
+        }
+    }
+    for (auto _: state) {
+        size_t accepted = 0;
+        for (const auto& text: texts) {
+            switch (state.range(0)) {
+                case 0: accepted += compiled.accepts(text); break;
+                case 1: accepted += keyword_search(text); break;
+                default: accepted += keyword_search_tables(text);
+            }
+        }
+        benchmark::DoNotOptimize(accepted);
+    }
+    state.SetBytesProcessed(state.iterations() * texts.size() * texts[0].size());
+}
+
+BENCHMARK(BM_GeneratedMatcher)->DenseRange(0, 2)->ArgNames({"generated"})->Unit(benchmark::kMillisecond);
+
+// Одно слово в 64 МБ через минимальный ДКА для (a|b)*a(a|b)^8: range(0) - число потоков, 0 - обычный accepts
+static void BM_LongText(benchmark::State& state) {
+    Automaton automaton = nth_letter_from_end(8);
+    automaton.determinize();
+    automaton.minimize();
+    const CompiledAutomaton compiled(automaton);
+    std::mt19937 rng(8);
+    string text(64 << 20, 'a');
+    for (auto& c: text) {
+        c = "ab"[rng() % 2];
+    }
+    ThreadPool pool(std::max<int64_t>(state.range(0), 1));
+    for (auto _: state) {
+        bool accepted = state.range(0) == 0 ? compiled.accepts(text) : compiled.accepts_parallel(text, pool);
+        benchmark::DoNotOptimize(accepted);
+    }
+    state.SetBytesProcessed(state.iterations() * text.size());
+}
+
+BENCHMARK(BM_LongText)->Arg(0)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_TableLayout)->ArgsProduct({{10000, 200000}, {0, 1}})->ArgNames({"states", "packed"});
+BENCHMARK(BM_BitParallelAccepts)->Arg(12)->Arg(40)->Arg(200)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_LazyAccepts)->Arg(12)->Arg(40)->Arg(200)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_CompileFromAutomaton)->Arg(100000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_LoadMapped)->Arg(100000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_AcceptsOneByOne)->ArgsProduct({{64, 100000}, {16, 256}});
+BENCHMARK(BM_AcceptsInterleaved)->ArgsProduct({{64, 100000}, {16, 256}});
+
+BENCHMARK_MAIN();
@@ -0,0 +1,252 @@
+#include "bit_parallel_matcher.h"
+
+BitParallelMatcher::BitParallelMatcher(Automaton automaton) {
+    automaton.make_one_letter();
+    const auto& states = automaton.get_states();
+    const auto& transitions = automaton.get_transitions();
+    state_number = states.size();
+    word_number = std::max<size_t>((state_number + 63) / 64, 1);
+    letter_number = automaton.get_letters().size();
+
+    letter_by_byte.fill(-1);
+    for (size_t letter = 0; letter < letter_number; ++letter) {
+        letter_by_byte[static_cast<unsigned char>(automaton.get_letters()[letter][0])] = letter;
+    }
+
+    // Новые номера состояний: от начального состояния идёт цепочка по первому ещё не занумерованному
+    // преемнику, потом цепочки от преемников уже занумерованных состояний по порядку, потом от
+    // недостижимых. Переходы вдоль цепочек становятся переходами i -> i + 1
+    vector<size_t> number(state_number, SIZE_MAX);
+    vector<size_t> order;
+    order.reserve(state_number);
+    auto chain_from = [&](size_t state) {
+        while (number[state] == SIZE_MAX) {
+            number[state] = order.size();
+            order.push_back(state);
+            for (const auto& transition: transitions[state]) {
+                if (number[transition.get_finish()] == SIZE_MAX) {
+                    state = transition.get_finish();
+                    break;
+                }
+            }
+        }
+    };
+    if (automaton.get_start_state() < state_number) {
+        chain_from(automaton.get_start_state());
+    }
+    for (size_t i = 0; i < order.size(); ++i) {
+        for (const auto& transition: transitions[order[i]]) {
+            chain_from(transition.get_finish());
+        }
+    }
+    for (size_t i = 0; i < state_number; ++i) {
+        chain_from(i);
+    }
+
+    start.assign(word_number, 0);
+    accept.assign(word_number, 0);
+    if (automaton.get_start_state() < state_number) {
+        size_t first = number[automaton.get_start_state()];
+        start[first / 64] |= 1ull << (first % 64);
+    }
+    for (size_t i = 0; i < state_number; ++i) {
+        if (states[i].get_is_accept()) {
+            accept[number[i] / 64] |= 1ull << (number[i] % 64);
+        }
+    }
+
+    const size_t chunks = 8 * word_number;
+    if (word_number <= MAX_TABLE_WORDS && letter_number * chunks * 256 * word_number <= MAX_TABLE_SIZE) {
+        // successors[letter][state][word] - маска переходов из состояния по букве
+        vector<uint64_t> successors(letter_number * state_number * word_number, 0);
+        for (size_t i = 0; i < state_number; ++i) {
+            for (const auto& transition: transitions[i]) {
+                size_t letter = automaton.get_letter_id(transition.get_expr());
+                size_t finish = number[transition.get_finish()];
+                successors[(letter * state_number + number[i]) * word_number + finish / 64] |= 1ull << (finish % 64);
+            }
+        }
+        // значение байта = значение без младшего бита + переходы из состояния младшего бита
+        byte_table.assign(letter_number * chunks * 256 * word_number, 0);
+        for (size_t letter = 0; letter < letter_number; ++letter) {
+            for (size_t chunk = 0; chunk < chunks; ++chunk) {
+                uint64_t* table = &byte_table[(letter * chunks + chunk) * 256 * word_number];
+                for (size_t byte = 1; byte < 256; ++byte) {
+                    size_t state = chunk * 8 + __builtin_ctz(byte);
+                    const uint64_t* previous = &table[(byte & (byte - 1)) * word_number];
+                    for (size_t w = 0; w < word_number; ++w) {
+                        table[byte * word_number + w] = previous[w];
+                        if (state < state_number) {
+                            table[byte * word_number + w] |= successors[(letter * state_number + state) * word_number + w];
+                        }
+                    }
+                }
+            }
+        }
+        return;
+    }
+
+    if (word_number == 1) {
+        successor_mask.assign(letter_number * 64, 0);
+        for (size_t i = 0; i < state_number; ++i) {
+            for (const auto& transition: transitions[i]) {
+                size_t letter = automaton.get_letter_id(transition.get_expr());
+                successor_mask[letter * 64 + number[i]] |= 1ull << number[transition.get_finish()];
+            }
+        }
+        return;
+    }
+
+    shift_mask.assign(letter_number * word_number, 0);
+    irregular_mask.assign(letter_number * word_number, 0);
+    irregular_start.assign(letter_number * state_number + 1, 0);
+    vector<pair<size_t, size_t>> irregular;  // (letter * state_number + state, finish)
+    for (size_t i = 0; i < state_number; ++i) {
+        for (const auto& transition: transitions[i]) {
+            size_t letter = automaton.get_letter_id(transition.get_expr());
+            size_t from = number[i];
+            size_t finish = number[transition.get_finish()];
+            if (finish == from + 1) {
+                shift_mask[letter * word_number + finish / 64] |= 1ull << (finish % 64);
+            } else {
+                irregular_mask[letter * word_number + from / 64] |= 1ull << (from % 64);
+                irregular.emplace_back(letter * state_number + from, finish);
+            }
+        }
+    }
+    // нерегулярные переходы - списками по (букве, состоянию), как CSR
+    std::sort(irregular.begin(), irregular.end());
+    irregular_targets.reserve(irregular.size());
+    for (const auto& [source, finish]: irregular) {
+        ++irregular_start[source + 1];
+        irregular_targets.push_back(finish);
+    }
+    for (size_t i = 0; i + 1 < irregular_start.size(); ++i) {
+        irregular_start[i + 1] += irregular_start[i];
+    }
+}
+
+bool BitParallelMatcher::accepts(std::string_view word) const {
+    if (!successor_mask.empty()) {
+        return _accepts_successors(word);
+    }
+    if (byte_table.empty()) {
+        return _accepts_shift(word);
+    }
+    return word_number == 1 ? _accepts_single_word(word) : _accepts_multi_word(word);
+}
+
+bool BitParallelMatcher::_accepts_single_word(std::string_view word) const {
+    uint64_t active = start[0];
+    for (const char& c: word) {
+        int32_t letter = letter_by_byte[static_cast<unsigned char>(c)];
+        if (letter < 0 || active == 0) {
+            return false;
+        }
+        const uint64_t* table = &byte_table[letter * 8 * 256];
+        uint64_t next = 0;
+        for (size_t chunk = 0; chunk < 8; ++chunk) {
+            next |= table[chunk * 256 + ((active >> (chunk * 8)) & 0xff)];
+        }
+        active = next;
+    }
+    return (active & accept[0]) != 0;
+}
+
+bool BitParallelMatcher::_accepts_successors(std::string_view word) const {
+    uint64_t active = start[0];
+    for (const char& c: word) {
+        int32_t letter = letter_by_byte[static_cast<unsigned char>(c)];
+        if (letter < 0 || active == 0) {
+            return false;
+        }
+        const uint64_t* successors = &successor_mask[letter * 64];
+        uint64_t next = 0;
+        for (uint64_t bits = active; bits != 0; bits &= bits - 1) {
+            next |= successors[__builtin_ctzll(bits)];
+        }
+        active = next;
+    }
+    return (active & accept[0]) != 0;
+}
+
+bool BitParallelMatcher::_accepts_multi_word(std::string_view word) const {
+    const size_t chunks = 8 * word_number;
+    vector<uint64_t> active = start;
+    vector<uint64_t> next(word_number);
+    for (const char& c: word) {
+        int32_t letter = letter_by_byte[static_cast<unsigned char>(c)];
+        if (letter < 0) {
+            return false;
+        }
+        std::fill(next.begin(), next.end(), 0);
+        bool any = false;
+        for (size_t w = 0; w < word_number; ++w) {
+            uint64_t bits = active[w];
+            any = any || bits != 0;
+            for (size_t chunk = w * 8; bits != 0; ++chunk, bits >>= 8) {
+                const uint64_t* from = &byte_table[((letter * chunks + chunk) * 256 + (bits & 0xff)) * word_number];
+                for (size_t v = 0; v < word_number; ++v) {
+                    next[v] |= from[v];
+                }
+            }
+        }
+        if (!any) {
+            return false;
+        }
+        swap(active, next);
+    }
+    for (size_t w = 0; w < word_number; ++w) {
+        if (active[w] & accept[w]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool BitParallelMatcher::_accepts_shift(std::string_view word) const {
+    vector<uint64_t> active = start;
+    vector<uint64_t> next(word_number);
+    for (const char& c: word) {
+        int32_t letter = letter_by_byte[static_cast<unsigned char>(c)];
+        if (letter < 0) {
+            return false;
+        }
+        const uint64_t* shift = &shift_mask[letter * word_number];
+        const uint64_t* irregular = &irregular_mask[letter * word_number];
+        const size_t* first = &irregular_start[letter * state_number];
+        uint64_t carry = 0;
+        bool any = false;
+        for (size_t w = 0; w < word_number; ++w) {
+            any = any || active[w] != 0;
+            next[w] = ((active[w] << 1) | carry) & shift[w];
+            carry = active[w] >> 63;
+        }
+        if (!any) {
+            return false;
+        }
+        for (size_t w = 0; w < word_number; ++w) {
+            for (uint64_t bits = active[w] & irregular[w]; bits != 0; bits &= bits - 1) {
+                size_t state = w * 64 + __builtin_ctzll(bits);
+                for (size_t i = first[state]; i < first[state + 1]; ++i) {
+                    next[irregular_targets[i] / 64] |= 1ull << (irregular_targets[i] % 64);
+                }
+            }
+        }
+        swap(active, next);
+    }
+    for (size_t w = 0; w < word_number; ++w) {
+        if (active[w] & accept[w]) {
+            return true;
+        }
+    }
+    return false;
+}
+
+const size_t& BitParallelMatcher::get_state_number() const {
+    return state_number;
+}
+
+const size_t& BitParallelMatcher::get_word_number() const {
+    return word_number;
+}
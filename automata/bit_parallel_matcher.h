@@ -0,0 +1,52 @@
+#ifndef AUTOMATA_BIT_PARALLEL_MATCHER_H
+#define AUTOMATA_BIT_PARALLEL_MATCHER_H
+
+#include "automata.h"
+#include <cstdint>
+
+
+// Моделирование НКА без детерминизации: множество активных состояний - битовая маска, шаг по букве -
+// объединение заранее посчитанных масок переходов. Пустые переходы убираются make_one_letter, так что
+// замыкание уже учтено в масках. Пока маска не длиннее MAX_TABLE_WORDS слов, шаг считается по таблицам для
+// каждого байта маски: в таблице байта лежит объединение переходов из всех отмеченных в нём состояний.
+// Таблицы строятся, только если помещаются в кэш (MAX_TABLE_SIZE слов). До 64 состояний маска - одно
+// машинное слово: с таблицами на букву приходится 8 обращений к памяти, без них (большой алфавит) шаг -
+// объединение масок преемников по одной маске на пару (буква, состояние). Для длинных масок шаг как в
+// алгоритме Shift-And для автомата Глушкова: состояния нумеруются цепочками, чтобы как можно больше
+// переходов были вида i -> i + 1, такие переходы делаются сдвигом всей маски и пересечением с маской
+// букв, а остальные ("нерегулярные") - по спискам только из тех активных состояний, у которых они есть
+class BitParallelMatcher{
+    static const size_t MAX_TABLE_SIZE = 1 << 15;
+    static const size_t MAX_TABLE_WORDS = 4;
+
+    size_t state_number;
+    size_t word_number;               // слов в маске
+    std::array<int32_t, 256> letter_by_byte{};
+    size_t letter_number;
+
+    vector<uint64_t> start;
+    vector<uint64_t> accept;
+    vector<uint64_t> byte_table;      // [letter][byte of mask][byte value][word], пустая - таблиц нет
+    vector<uint64_t> successor_mask;  // [letter][state] - при одном слове маски, если таблицы не строятся
+    vector<uint64_t> shift_mask;      // [letter][word] - состояния i + 1, в которые из i ведёт буква
+    vector<uint64_t> irregular_mask;  // [letter][word] - состояния с нерегулярными переходами по букве
+    vector<size_t> irregular_start;   // [letter * state_number + state] - начало списка в irregular_targets
+    vector<size_t> irregular_targets;
+
+public:
+    BitParallelMatcher() = delete;
+    explicit BitParallelMatcher(Automaton automaton);
+
+    [[nodiscard]] bool accepts(std::string_view word) const;
+
+    [[nodiscard]] const size_t& get_state_number() const;
+    [[nodiscard]] const size_t& get_word_number() const;
+
+private:
+    [[nodiscard]] bool _accepts_single_word(std::string_view word) const;
+    [[nodiscard]] bool _accepts_multi_word(std::string_view word) const;
+    [[nodiscard]] bool _accepts_successors(std::string_view word) const;
+    [[nodiscard]] bool _accepts_shift(std::string_view word) const;
+};
+
+#endif //AUTOMATA_BIT_PARALLEL_MATCHER_H
@@ -0,0 +1,74 @@
+#include "automata.h"
+#include "multi_pattern.h"
+#include <cctype>
+#include <fstream>
+
+// Генерация заголовка с функцией поиска по фиксированному набору слов:
+// codegen <файл> <имя функции> <слово>...
+// Функция принимает тексты, которые заканчиваются одним из слов, <имя функции>_tables - то же
+// на constexpr-таблицах; сами слова записываются в массив <имя функции>_patterns, чтобы по ним
+// можно было построить тот же автомат заново
+static bool is_identifier(const string& name) {
+    if (name.empty() || std::isdigit(static_cast<unsigned char>(name[0]))) {
+        return false;
+    }
+    return std::all_of(name.begin(), name.end(), [](char c) {
+        return c == '_' || std::isalnum(static_cast<unsigned char>(c));
+    });
+}
+
+// Строковый литерал C++: кавычки и обратная косая черта экранируются, непечатаемые байты - восьмеричными кодами
+static string string_literal(const string& word) {
+    string result = "\"";
+    for (const char& c: word) {
+        auto byte = static_cast<unsigned char>(c);
+        if (c == '"' || c == '\\') {
+            result += '\\';
+            result += c;
+        } else if (std::isprint(byte)) {
+            result += c;
+        } else {
+            result += '\\';
+            result += static_cast<char>('0' + (byte >> 6));
+            result += static_cast<char>('0' + ((byte >> 3) & 7));
+            result += static_cast<char>('0' + (byte & 7));
+        }
+    }
+    return result + '"';
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 4) {
+        std::cerr << "Usage: " << argv[0] << " <output header> <function name> <word>...\n";
+        return 1;
+    }
+    const string function_name = argv[2];
+    if (!is_identifier(function_name)) {
+        std::cerr << "Function name \"" << function_name << "\" is not a C++ identifier\n";
+        return 1;
+    }
+    vector<string> words(argv + 3, argv + argc);
+    vector<Automaton> patterns;
+    for (const auto& word: words) {
+        vector<State> st = {State("0", true, false), State("1", false, true)};
+        vector<set<Transition>> tr {{Transition(word, 1)}, {}};
+        patterns.emplace_back(st, tr);
+    }
+    Automaton automaton = pattern_union(patterns, true);
+    automaton.determinize();
+    automaton.minimize();
+
+    std::ofstream output(argv[1]);
+    output << "#pragma once\n\n"
+              "#include <cstdint>\n"
+              "#include <string_view>\n\n";
+    output << "inline constexpr const char* " << function_name << "_patterns[] = {";
+    for (size_t i = 0; i < words.size(); ++i) {
+        output << (i ? ", " : "") << string_literal(words[i]);
+    }
+    output << "};\n\n";
+    automaton.cpp_matcher_print(output, function_name);
+    output << "\n";
+    automaton.cpp_matcher_print(output, function_name + "_tables", true);
+    return output ? 0 : 1;
+}
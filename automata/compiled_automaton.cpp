@@ -0,0 +1,734 @@
+#include "compiled_automaton.h"
+#include "mapped_file.h"
+#include <cstring>
+#include <fstream>
+
+[[nodiscard]] const char* bad_automaton_file_exception::what() const noexcept {
+    return "File doesn't contain compiled automaton of supported version!\n";
+}
+
+[[nodiscard]] const char* automaton_write_exception::what() const noexcept {
+    return "Can't write compiled automaton to file!\n";
+}
+
+
+// Заголовок файла с автоматом, за ним сразу идёт symbol_by_byte
+struct _CompiledAutomatonHeader{
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t state_number;
+    uint64_t width;
+    int64_t start_state;
+    uint64_t layout;
+    uint64_t packed_size;       // длина table и check для row_displacement
+    uint64_t table_offset;
+    uint64_t base_offset;
+    uint64_t check_offset;
+    uint64_t accept_offset;
+    uint64_t id_set_number;
+    uint64_t id_number;
+    uint64_t id_set_by_state_offset;
+    uint64_t id_set_start_offset;
+    uint64_t ids_offset;
+    uint64_t file_size;
+};
+
+// Собственные буферы скомпилированного автомата
+struct _CompiledAutomatonBuffers{
+    vector<int32_t> table;
+    vector<int32_t> base;
+    vector<int32_t> check;
+    vector<unsigned long long> accept;
+    vector<uint32_t> id_set_by_state;
+    vector<uint32_t> id_set_start;
+    vector<uint32_t> ids;
+};
+
+static const char AUTOMATON_FILE_MAGIC[8] = {'A', 'U', 'T', 'O', 'M', 'D', 'F', 'A'};
+static const uint32_t AUTOMATON_FILE_BYTE_ORDER = 0x01020304;
+
+static uint64_t _align_to_8(const uint64_t& offset) {
+    return (offset + 7) / 8 * 8;
+}
+
+
+
+//CompiledAutomaton
+
+CompiledAutomaton::CompiledAutomaton(const Automaton& automaton, TableLayout layout): CompiledAutomaton() {
+    state_number = automaton.get_states().size();
+    const auto& transitions = automaton.get_transitions();
+    const size_t letter_number = automaton.get_letters().size();
+
+    // columns[letter][state]; последний столбец - для байтов не из алфавита
+    vector<vector<int32_t>> columns(letter_number + 1, vector<int32_t>(state_number, DEAD_STATE));
+    auto buffers = std::make_shared<_CompiledAutomatonBuffers>();
+    auto& owned_table = buffers->table;
+    auto& owned_accept = buffers->accept;
+    owned_accept.assign((state_number + 63) / 64, 0);
+    map<vector<size_t>, uint32_t> id_sets = {{vector<size_t>(), 0}};
+    buffers->id_set_by_state.assign(state_number, 0);
+    buffers->id_set_start = {0, 0};
+    for (size_t i = 0; i < state_number; ++i) {
+        for (const auto& transition: transitions[i]) {
+            if (transition.get_expr().size() != 1) {
+                throw not_deterministic_exception();
+            }
+            auto& cell = columns[automaton.get_letter_id(transition.get_expr())][i];
+            if (cell != DEAD_STATE) {
+                throw not_deterministic_exception();
+            }
+            cell = static_cast<int32_t>(transition.get_finish());
+        }
+        if (automaton.get_states()[i].get_is_accept()) {
+            owned_accept[i / 64] |= 1ull << (i % 64);
+        }
+        const auto& accept_ids = automaton.get_states()[i].get_accept_ids();
+        auto [id_set, is_new] = id_sets.emplace(accept_ids, id_sets.size());
+        if (is_new) {
+            buffers->ids.insert(buffers->ids.end(), accept_ids.begin(), accept_ids.end());
+            buffers->id_set_start.push_back(buffers->ids.size());
+        }
+        buffers->id_set_by_state[i] = id_set->second;
+    }
+
+    // одинаковые столбцы склеиваются в один класс
+    map<vector<int32_t>, int32_t> classes;
+    vector<int32_t> class_by_letter(letter_number + 1);
+    vector<const vector<int32_t>*> class_columns;
+    for (size_t letter = 0; letter <= letter_number; ++letter) {
+        auto [iter, is_new] = classes.emplace(columns[letter], class_columns.size());
+        if (is_new) {
+            class_columns.push_back(&iter->first);
+        }
+        class_by_letter[letter] = iter->second;
+    }
+    width = class_columns.size();
+    symbol_by_byte.fill(class_by_letter[letter_number]);
+    for (size_t letter = 0; letter < letter_number; ++letter) {
+        symbol_by_byte[static_cast<unsigned char>(automaton.get_letters()[letter][0])] = class_by_letter[letter];
+    }
+
+    owned_table.resize(state_number * width);
+    for (size_t i = 0; i < state_number; ++i) {
+        for (size_t symbol = 0; symbol < width; ++symbol) {
+            owned_table[i * width + symbol] = (*class_columns[symbol])[i];
+        }
+    }
+    if (automaton.get_start_state() < state_number) {
+        start_state = static_cast<int32_t>(automaton.get_start_state());
+    }
+    if (layout == TableLayout::row_displacement) {
+        _pack_rows(owned_table, buffers->base, buffers->check);
+        base = buffers->base.data();
+        check = buffers->check.data();
+        packed_size = owned_table.size();
+    }
+    table = owned_table.data();
+    accept = owned_accept.data();
+    id_set_number = buffers->id_set_start.size() - 1;
+    id_number = buffers->ids.size();
+    id_set_by_state = buffers->id_set_by_state.data();
+    id_set_start = buffers->id_set_start.data();
+    ids = buffers->ids.data();
+    storage = std::move(buffers);
+}
+
+// Строки кладутся по убыванию числа переходов, каждая - с первого сдвига, где все её переходы
+// попадают в свободные ячейки (поиск ограничен, чтобы упаковка оставалась линейной). Массивы дополняются до max(base) + width, чтобы шаг не проверял границы
+void CompiledAutomaton::_pack_rows(vector<int32_t>& dense, vector<int32_t>& owned_base, vector<int32_t>& owned_check) {
+    vector<vector<int32_t>> symbols(state_number);
+    for (size_t i = 0; i < state_number; ++i) {
+        for (size_t symbol = 0; symbol < width; ++symbol) {
+            if (dense[i * width + symbol] != DEAD_STATE) {
+                symbols[i].push_back(symbol);
+            }
+        }
+    }
+    vector<size_t> order(state_number);
+    for (size_t i = 0; i < state_number; ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](const size_t& i, const size_t& j) {
+        return symbols[i].size() > symbols[j].size();
+    });
+
+    vector<int32_t> packed;
+    owned_check.clear();
+    owned_base.assign(state_number, 0);
+    size_t first_free = 0;
+    size_t used_end = 0;
+    for (const size_t& i: order) {
+        if (symbols[i].empty()) {
+            break;
+        }
+        while (first_free < owned_check.size() && owned_check[first_free] != DEAD_STATE) {
+            ++first_free;
+        }
+        size_t shift = first_free >= static_cast<size_t>(symbols[i][0]) ? first_free - symbols[i][0] : 0;
+        auto fits = [&](const size_t& candidate) {
+            for (const auto& symbol: symbols[i]) {
+                if (candidate + symbol < owned_check.size() && owned_check[candidate + symbol] != DEAD_STATE) {
+                    return false;
+                }
+            }
+            return true;
+        };
+        // дыры у first_free могут так и не заполниться: после MAX_ATTEMPTS неудач поиск для следующих строк
+        // начинается дальше, а эта строка идёт сразу за последней занятой ячейкой
+        static const size_t MAX_ATTEMPTS = 256;
+        size_t attempt = 0;
+        while (attempt < MAX_ATTEMPTS && !fits(shift)) {
+            ++shift;
+            ++attempt;
+        }
+        if (attempt == MAX_ATTEMPTS) {
+            first_free = shift + symbols[i][0];
+            shift = std::max<size_t>(used_end, symbols[i][0]) - symbols[i][0];
+        }
+        if (shift + width > owned_check.size()) {
+            owned_check.resize(shift + width, DEAD_STATE);
+            packed.resize(shift + width, DEAD_STATE);
+        }
+        owned_base[i] = static_cast<int32_t>(shift);
+        for (const auto& symbol: symbols[i]) {
+            owned_check[shift + symbol] = static_cast<int32_t>(i);
+            packed[shift + symbol] = dense[i * width + symbol];
+        }
+        used_end = std::max<size_t>(used_end, shift + symbols[i].back() + 1);
+    }
+    if (owned_check.size() < width) {
+        owned_check.resize(width, DEAD_STATE);
+        packed.resize(width, DEAD_STATE);
+    }
+    packed.shrink_to_fit();
+    owned_check.shrink_to_fit();
+    dense = std::move(packed);
+}
+
+CompiledAutomaton CompiledAutomaton::determinized(Automaton automaton) {
+    automaton.determinize();
+    return CompiledAutomaton(automaton);
+}
+
+void CompiledAutomaton::save(const string& path) const {
+    _CompiledAutomatonHeader header{};
+    std::memcpy(header.magic, AUTOMATON_FILE_MAGIC, sizeof(header.magic));
+    header.version = FORMAT_VERSION;
+    header.byte_order = AUTOMATON_FILE_BYTE_ORDER;
+    header.state_number = state_number;
+    header.width = width;
+    header.start_state = start_state;
+    const size_t table_size = base ? packed_size : state_number * width;
+    const size_t base_size = base ? state_number : 0;
+    const size_t check_size = base ? packed_size : 0;
+    header.layout = static_cast<uint64_t>(get_layout());
+    header.packed_size = packed_size;
+    header.table_offset = _align_to_8(sizeof(header) + sizeof(symbol_by_byte));
+    header.base_offset = _align_to_8(header.table_offset + table_size * sizeof(int32_t));
+    header.check_offset = _align_to_8(header.base_offset + base_size * sizeof(int32_t));
+    header.accept_offset = _align_to_8(header.check_offset + check_size * sizeof(int32_t));
+    header.id_set_number = id_set_number;
+    header.id_number = id_number;
+    header.id_set_by_state_offset = header.accept_offset + (state_number + 63) / 64 * sizeof(unsigned long long);
+    header.id_set_start_offset = _align_to_8(header.id_set_by_state_offset + state_number * sizeof(uint32_t));
+    header.ids_offset = _align_to_8(header.id_set_start_offset + (id_set_number + 1) * sizeof(uint32_t));
+    header.file_size = header.ids_offset + id_number * sizeof(uint32_t);
+
+    std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+    if (!stream) {
+        throw automaton_write_exception();
+    }
+    // секции пишутся по порядку, промежутки до их смещений заполняются нулями
+    uint64_t written = 0;
+    auto write = [&](const uint64_t& offset, const void* data, const size_t& size) {
+        const char zeros[8] = {};
+        stream.write(zeros, offset - written);
+        stream.write(static_cast<const char*>(data), size);
+        written = offset + size;
+    };
+    write(0, &header, sizeof(header));
+    write(sizeof(header), symbol_by_byte.data(), sizeof(symbol_by_byte));
+    write(header.table_offset, table, table_size * sizeof(int32_t));
+    write(header.base_offset, base, base_size * sizeof(int32_t));
+    write(header.check_offset, check, check_size * sizeof(int32_t));
+    write(header.accept_offset, accept, (state_number + 63) / 64 * sizeof(unsigned long long));
+    write(header.id_set_by_state_offset, id_set_by_state, state_number * sizeof(uint32_t));
+    write(header.id_set_start_offset, id_set_start, (id_set_number + 1) * sizeof(uint32_t));
+    write(header.ids_offset, ids, id_number * sizeof(uint32_t));
+    if (!stream) {
+        throw automaton_write_exception();
+    }
+}
+
+CompiledAutomaton CompiledAutomaton::load(const string& path) {
+    auto file = std::make_shared<MappedFile>(path);
+    std::string_view bytes = file->view();
+
+    _CompiledAutomatonHeader header{};
+    if (bytes.size() < sizeof(header) + sizeof(symbol_by_byte)) {
+        throw bad_automaton_file_exception();
+    }
+    std::memcpy(&header, bytes.data(), sizeof(header));
+    // секция из count элементов по element_size байт целиком лежит в файле после заголовка; без сложений,
+    // которые могут переполниться: иначе смещение около 2^64 проходит проверку и указывает до начала файла
+    auto section_fits = [&](const uint64_t& offset, const uint64_t& count, const uint64_t& element_size) {
+        return offset % 8 == 0 && offset >= sizeof(header) + sizeof(symbol_by_byte) && offset <= header.file_size &&
+               count <= (header.file_size - offset) / element_size;
+    };
+    const bool is_packed = header.layout == static_cast<uint64_t>(TableLayout::row_displacement);
+    if (std::memcmp(header.magic, AUTOMATON_FILE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != FORMAT_VERSION ||
+        header.byte_order != AUTOMATON_FILE_BYTE_ORDER ||
+        header.file_size != bytes.size() ||
+        header.state_number >= static_cast<uint64_t>(INT32_MAX) ||
+        header.width == 0 || header.width > 257 ||
+        header.start_state < DEAD_STATE || header.start_state >= static_cast<int64_t>(header.state_number) ||
+        header.layout > static_cast<uint64_t>(TableLayout::row_displacement) ||
+        (is_packed && (header.packed_size < header.width || header.packed_size >= static_cast<uint64_t>(INT32_MAX)))) {
+        throw bad_automaton_file_exception();
+    }
+    const uint64_t table_size = is_packed ? header.packed_size : header.state_number * header.width;
+    const uint64_t base_size = is_packed ? header.state_number : 0;
+    const uint64_t check_size = is_packed ? header.packed_size : 0;
+    const uint64_t accept_size = (header.state_number + 63) / 64;
+    // после проверки section_fits суммы смещений и длин не больше file_size и уже не переполняются
+    if (!section_fits(header.table_offset, table_size, sizeof(int32_t)) ||
+        !section_fits(header.base_offset, base_size, sizeof(int32_t)) ||
+        !section_fits(header.check_offset, check_size, sizeof(int32_t)) ||
+        !section_fits(header.accept_offset, accept_size, sizeof(unsigned long long)) ||
+        header.id_set_number >= static_cast<uint64_t>(UINT32_MAX) || header.id_number > static_cast<uint64_t>(UINT32_MAX) ||
+        !section_fits(header.id_set_by_state_offset, header.state_number, sizeof(uint32_t)) ||
+        !section_fits(header.id_set_start_offset, header.id_set_number + 1, sizeof(uint32_t)) ||
+        !section_fits(header.ids_offset, header.id_number, sizeof(uint32_t)) ||
+        header.base_offset < header.table_offset + table_size * sizeof(int32_t) ||
+        header.check_offset < header.base_offset + base_size * sizeof(int32_t) ||
+        header.accept_offset < header.check_offset + check_size * sizeof(int32_t) ||
+        header.id_set_by_state_offset < header.accept_offset + accept_size * sizeof(unsigned long long) ||
+        header.id_set_start_offset < header.id_set_by_state_offset + header.state_number * sizeof(uint32_t) ||
+        header.ids_offset < header.id_set_start_offset + (header.id_set_number + 1) * sizeof(uint32_t)) {
+        throw bad_automaton_file_exception();
+    }
+
+    CompiledAutomaton result;
+    result.state_number = header.state_number;
+    result.width = header.width;
+    result.start_state = static_cast<int32_t>(header.start_state);
+    std::memcpy(result.symbol_by_byte.data(), bytes.data() + sizeof(header), sizeof(result.symbol_by_byte));
+    for (const auto& symbol: result.symbol_by_byte) {
+        if (symbol < 0 || static_cast<uint64_t>(symbol) >= header.width) {
+            throw bad_automaton_file_exception();
+        }
+    }
+    // mmap выравнивает начало по странице, поэтому смещения, кратные 8, дают выровненные указатели
+    result.table = reinterpret_cast<const int32_t*>(bytes.data() + header.table_offset);
+    if (header.layout == static_cast<uint64_t>(TableLayout::row_displacement)) {
+        result.base = reinterpret_cast<const int32_t*>(bytes.data() + header.base_offset);
+        result.check = reinterpret_cast<const int32_t*>(bytes.data() + header.check_offset);
+        result.packed_size = header.packed_size;
+    }
+    result.accept = reinterpret_cast<const unsigned long long*>(bytes.data() + header.accept_offset);
+    result.id_set_number = header.id_set_number;
+    result.id_number = header.id_number;
+    result.id_set_by_state = reinterpret_cast<const uint32_t*>(bytes.data() + header.id_set_by_state_offset);
+    result.id_set_start = reinterpret_cast<const uint32_t*>(bytes.data() + header.id_set_start_offset);
+    result.ids = reinterpret_cast<const uint32_t*>(bytes.data() + header.ids_offset);
+    auto is_state = [&](const int32_t& state) {
+        return state >= DEAD_STATE && state < static_cast<int64_t>(header.state_number);
+    };
+    if (!std::all_of(result.table, result.table + table_size, is_state)) {
+        throw bad_automaton_file_exception();
+    }
+    // строка каждого состояния целиком лежит в упакованных массивах, а check хранит номера состояний
+    if (is_packed &&
+        (!std::all_of(result.check, result.check + header.packed_size, is_state) ||
+         !std::all_of(result.base, result.base + header.state_number, [&](const int32_t& shift) {
+             return shift >= 0 && static_cast<uint64_t>(shift) + header.width <= header.packed_size;
+         }))) {
+        throw bad_automaton_file_exception();
+    }
+    // наборы идут подряд и кончаются ровно на id_number, и номер набора у каждого состояния существует
+    if (result.id_set_start[0] != 0 || result.id_set_start[header.id_set_number] != header.id_number ||
+        !std::is_sorted(result.id_set_start, result.id_set_start + header.id_set_number + 1) ||
+        !std::all_of(result.id_set_by_state, result.id_set_by_state + header.state_number,
+                     [&](const uint32_t& id_set) { return id_set < header.id_set_number; })) {
+        throw bad_automaton_file_exception();
+    }
+    result.storage = std::move(file);
+    return result;
+}
+
+const size_t& CompiledAutomaton::get_state_number() const {
+    return state_number;
+}
+
+const size_t& CompiledAutomaton::get_class_number() const {
+    return width;
+}
+
+const int32_t& CompiledAutomaton::get_start_state() const {
+    return start_state;
+}
+
+TableLayout CompiledAutomaton::get_layout() const {
+    return base ? TableLayout::row_displacement : TableLayout::dense;
+}
+
+size_t CompiledAutomaton::get_table_bytes() const {
+    return (base ? 2 * packed_size + state_number : state_number * width) * sizeof(int32_t);
+}
+
+bool CompiledAutomaton::accepts(std::string_view word) const {
+    int32_t state = _run(start_state, word);
+    return state != DEAD_STATE && is_accept(state);
+}
+
+int32_t CompiledAutomaton::_run(int32_t state, std::string_view text) const {
+    for (size_t i = 0; i < text.size() && state != DEAD_STATE; ++i) {
+        state = step(state, text[i]);
+    }
+    return state;
+}
+
+vector<int32_t> CompiledAutomaton::_chunk_mapping(std::string_view chunk) const {
+    static const size_t BLOCK = 64;     // столько байт дорожки проходят между склейками
+    static const size_t MAX_LANES = 4;  // больше дорожек после первого блока - кусок дешевле прочитать по порядку
+
+    // первый блок из всех состояний не должен стоить больше, чем весь кусок из одного
+    if (state_number * BLOCK > chunk.size()) {
+        return {};
+    }
+
+    // дорожка с номером id началась в состоянии id; склеенная дорожка ссылается на ту, с которой склеилась
+    vector<int32_t> parent(state_number);
+    vector<int32_t> lanes(state_number);
+    vector<int32_t> current(state_number);
+    for (size_t i = 0; i < state_number; ++i) {
+        parent[i] = lanes[i] = current[i] = static_cast<int32_t>(i);
+    }
+    vector<int32_t> owner(state_number + 1, -1);  // owner[state + 1] - дорожка, уже пришедшая в state
+    for (size_t position = 0; position < chunk.size() && !lanes.empty(); position += BLOCK) {
+        std::string_view block = chunk.substr(position, BLOCK);
+        size_t kept = 0;
+        for (size_t lane = 0; lane < lanes.size(); ++lane) {
+            int32_t state = _run(current[lane], block);
+            int32_t& same = owner[state + 1];
+            if (same == -1) {
+                same = lanes[lane];
+                lanes[kept] = lanes[lane];
+                current[kept] = state;
+                ++kept;
+            } else {
+                parent[lanes[lane]] = same;
+            }
+        }
+        lanes.resize(kept);
+        current.resize(kept);
+        for (const int32_t& state: current) {
+            owner[state + 1] = -1;
+        }
+        // ДКА не сходится в одно состояние (например, счётчик по модулю) - отказываемся от догадки
+        if (lanes.size() > MAX_LANES) {
+            return {};
+        }
+    }
+
+    vector<int32_t> final_state(state_number, DEAD_STATE);
+    for (size_t lane = 0; lane < lanes.size(); ++lane) {
+        final_state[lanes[lane]] = current[lane];
+    }
+    vector<int32_t> mapping(state_number);
+    for (size_t i = 0; i < state_number; ++i) {
+        int32_t root = static_cast<int32_t>(i);
+        while (parent[root] != root) {
+            root = parent[root];
+        }
+        for (int32_t j = static_cast<int32_t>(i); parent[j] != root; ) {
+            int32_t next = parent[j];
+            parent[j] = root;
+            j = next;
+        }
+        mapping[i] = final_state[root];
+    }
+    return mapping;
+}
+
+int32_t CompiledAutomaton::run_parallel(std::string_view text, ThreadPool& pool) const {
+    static const size_t MIN_CHUNK = 1 << 16;
+    size_t chunk_number = std::min(pool.get_thread_number(), text.size() / MIN_CHUNK);
+    if (chunk_number <= 1 || start_state == DEAD_STATE) {
+        return _run(start_state, text);
+    }
+    vector<size_t> bounds(chunk_number + 1);
+    for (size_t chunk = 0; chunk <= chunk_number; ++chunk) {
+        bounds[chunk] = text.size() / chunk_number * chunk;
+    }
+    bounds.back() = text.size();
+
+    int32_t first_result = DEAD_STATE;
+    vector<vector<int32_t>> mappings(chunk_number);
+    pool.parallel_for(chunk_number, 1, [&](size_t begin, size_t end) {
+        for (size_t chunk = begin; chunk < end; ++chunk) {
+            std::string_view part = text.substr(bounds[chunk], bounds[chunk + 1] - bounds[chunk]);
+            if (chunk == 0) {
+                first_result = _run(start_state, part);
+            } else {
+                mappings[chunk] = _chunk_mapping(part);
+            }
+        }
+    });
+    // кусков столько же, сколько потоков, поэтому отображения применяются просто по очереди;
+    // кусок без отображения читается здесь же из уже известного состояния
+    int32_t state = first_result;
+    for (size_t chunk = 1; chunk < chunk_number && state != DEAD_STATE; ++chunk) {
+        if (mappings[chunk].empty()) {
+            state = _run(state, text.substr(bounds[chunk], bounds[chunk + 1] - bounds[chunk]));
+        } else {
+            state = mappings[chunk][state];
+        }
+    }
+    return state;
+}
+
+bool CompiledAutomaton::accepts_parallel(std::string_view text, ThreadPool& pool) const {
+    int32_t state = run_parallel(text, pool);
+    return state != DEAD_STATE && is_accept(state);
+}
+
+vector<uint32_t> CompiledAutomaton::matching_ids(std::string_view word) const {
+    int32_t state = start_state;
+    for (size_t i = 0; i < word.size() && state != DEAD_STATE; ++i) {
+        state = step(state, word[i]);
+    }
+    if (state == DEAD_STATE) {
+        return {};
+    }
+    auto [begin, end] = get_accept_ids(state);
+    return vector<uint32_t>(begin, end);
+}
+
+vector<pair<size_t, uint32_t>> CompiledAutomaton::find_pattern_ids(std::string_view text) const {
+    vector<pair<size_t, uint32_t>> result;
+    if (start_state == DEAD_STATE) {
+        return result;
+    }
+    int32_t state = start_state;
+    for (size_t i = 0; i < text.size(); ++i) {
+        state = step(state, text[i]);
+        if (state == DEAD_STATE) {
+            state = start_state;
+            continue;
+        }
+        // у большинства состояний набор пустой, и проверка - одно сравнение номера набора
+        if (id_set_by_state[state] != 0) {
+            auto [begin, end] = get_accept_ids(state);
+            for (const uint32_t* id = begin; id != end; ++id) {
+                result.emplace_back(i + 1, *id);
+            }
+        }
+    }
+    return result;
+}
+
+vector<unsigned long long> CompiledAutomaton::accepts_batch(const vector<std::string_view>& words, ThreadPool& pool) const {
+    vector<unsigned long long> result((words.size() + 63) / 64, 0);
+    // границы отрезков кратны 64, поэтому каждое слово маски пишет ровно один поток
+    pool.parallel_for(words.size(), 64, [&](size_t begin, size_t end) {
+        _accepts_interleaved(words.data(), begin, end, result);
+    });
+    return result;
+}
+
+vector<unsigned long long> CompiledAutomaton::accepts_interleaved(const vector<std::string_view>& words) const {
+    vector<unsigned long long> result((words.size() + 63) / 64, 0);
+    _accepts_interleaved(words.data(), 0, words.size(), result);
+    return result;
+}
+
+void CompiledAutomaton::_accepts_interleaved(const std::string_view* words, size_t begin, size_t end,
+                                             vector<unsigned long long>& result) const {
+    // без стартового состояния (в том числе в пустой таблице) ничего не принимается, а строки 0 может не быть
+    if (start_state == DEAD_STATE) {
+        return;
+    }
+    // ветвление по виду таблицы - один раз на весь отрезок, а не на каждый шаг
+    if (base == nullptr) {
+        _accepts_interleaved(words, begin, end, result, [&](const int32_t& state, const int32_t& symbol) {
+            return table[state * width + symbol];
+        });
+    } else {
+        _accepts_interleaved(words, begin, end, result, [&](const int32_t& state, const int32_t& symbol) {
+            size_t index = base[state] + symbol;
+            return check[index] == state ? table[index] : DEAD_STATE;
+        });
+    }
+}
+
+template<typename Lookup>
+void CompiledAutomaton::_accepts_interleaved(const std::string_view* words, size_t begin, size_t end,
+                                             vector<unsigned long long>& result, Lookup&& lookup) const {
+    // дорожки хранятся отдельными массивами, чтобы внутренний цикл был одинаковым для всех дорожек
+    std::array<const unsigned char*, LANES> data{};
+    std::array<size_t, LANES> left{};
+    std::array<int32_t, LANES> state{};
+    std::array<size_t, LANES> index{};
+
+    auto finish = [&](size_t lane) {
+        if (state[lane] != DEAD_STATE && is_accept(state[lane])) {
+            result[index[lane] / 64] |= 1ull << (index[lane] % 64);
+        }
+    };
+    auto load = [&](size_t lane, size_t i) {
+        data[lane] = reinterpret_cast<const unsigned char*>(words[i].data());
+        left[lane] = words[i].size();
+        state[lane] = start_state;
+        index[lane] = i;
+    };
+
+    size_t next = begin;
+    if (end - begin >= LANES) {
+        for (size_t lane = 0; lane < LANES; ++lane) {
+            load(lane, next++);
+        }
+        while (true) {
+            size_t steps = left[0];
+            for (size_t lane = 1; lane < LANES; ++lane) {
+                steps = std::min(steps, left[lane]);
+            }
+            // DEAD_STATE остаётся на месте: читаем строку 0, но результат отбрасываем, чтобы не было ветвлений
+            for (size_t k = 0; k < steps; ++k) {
+                for (size_t lane = 0; lane < LANES; ++lane) {
+                    int32_t current = state[lane];
+                    int32_t following = lookup(std::max(current, 0), symbol_by_byte[data[lane][k]]);
+                    state[lane] = current < 0 ? current : following;
+                }
+            }
+            bool refilled = true;
+            for (size_t lane = 0; lane < LANES; ++lane) {
+                data[lane] += steps;
+                left[lane] -= steps;
+                if (left[lane] == 0) {
+                    finish(lane);
+                    if (next == end) {
+                        refilled = false;
+                        left[lane] = 0;
+                        state[lane] = DEAD_STATE;
+                        index[lane] = end;
+                    } else {
+                        load(lane, next++);
+                    }
+                }
+            }
+            if (!refilled) {
+                break;
+            }
+        }
+        // слова кончились: оставшиеся дорожки доводим по одной
+        for (size_t lane = 0; lane < LANES; ++lane) {
+            if (index[lane] == end) {
+                continue;
+            }
+            for (size_t k = 0; k < left[lane] && state[lane] != DEAD_STATE; ++k) {
+                state[lane] = step(state[lane], data[lane][k]);
+            }
+            finish(lane);
+        }
+    }
+    for (size_t i = next; i < end; ++i) {
+        if (accepts(words[i])) {
+            result[i / 64] |= 1ull << (i % 64);
+        }
+    }
+}
+
+// Границы кусков: каждая - начало строки, первая 0, последняя text.size()
+vector<size_t> CompiledAutomaton::_split_by_lines(std::string_view text, size_t chunk_number) const {
+    vector<size_t> bounds = {0};
+    for (size_t i = 1; i < chunk_number; ++i) {
+        size_t bound = std::max(bounds.back(), text.size() / chunk_number * i);
+        size_t line_end = text.find('\n', bound == 0 ? 0 : bound - 1);
+        bound = (line_end == std::string_view::npos) ? text.size() : line_end + 1;
+        if (bound > bounds.back() && bound < text.size()) {
+            bounds.push_back(bound);
+        }
+    }
+    bounds.push_back(text.size());
+    return bounds;
+}
+
+// Проверяет строки, начинающиеся в [begin, end), и вызывает on_match(начало строки) для подходящих
+template<typename OnMatch>
+void CompiledAutomaton::_scan_lines(std::string_view text, size_t begin, size_t end, OnMatch&& on_match) const {
+    const auto* bytes = reinterpret_cast<const unsigned char*>(text.data());
+    size_t position = begin;
+    while (position < end) {
+        size_t line_start = position;
+        int32_t state = start_state;
+        while (position < text.size() && bytes[position] != '\n') {
+            if (state == DEAD_STATE) {
+                // строка уже не подходит - просто ищем её конец
+                const void* line_end = std::memchr(bytes + position, '\n', text.size() - position);
+                position = line_end ? static_cast<const unsigned char*>(line_end) - bytes : text.size();
+                break;
+            }
+            state = step(state, bytes[position]);
+            ++position;
+        }
+        if (state != DEAD_STATE && is_accept(state)) {
+            on_match(line_start);
+        }
+        ++position;  // пропускаем '\n'
+    }
+}
+
+size_t CompiledAutomaton::count_matching_lines(std::string_view text, ThreadPool& pool) const {
+    auto bounds = _split_by_lines(text, pool.get_thread_number() * 4);
+    vector<size_t> counts(bounds.size() - 1, 0);
+    pool.parallel_for(counts.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t chunk = begin; chunk < end; ++chunk) {
+            size_t count = 0;
+            _scan_lines(text, bounds[chunk], bounds[chunk + 1], [&](size_t) { ++count; });
+            counts[chunk] = count;
+        }
+    });
+    size_t total = 0;
+    for (const auto& count: counts) {
+        total += count;
+    }
+    return total;
+}
+
+vector<size_t> CompiledAutomaton::matching_line_offsets(std::string_view text, ThreadPool& pool) const {
+    auto bounds = _split_by_lines(text, pool.get_thread_number() * 4);
+    vector<vector<size_t>> offsets(bounds.size() - 1);
+    pool.parallel_for(offsets.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t chunk = begin; chunk < end; ++chunk) {
+            _scan_lines(text, bounds[chunk], bounds[chunk + 1], [&](size_t offset) {
+                offsets[chunk].push_back(offset);
+            });
+        }
+    });
+    vector<size_t> result;
+    for (const auto& chunk_offsets: offsets) {
+        result.insert(result.end(), chunk_offsets.begin(), chunk_offsets.end());
+    }
+    return result;
+}
+
+
+vector<vector<unsigned char>> joint_letter_classes(const CompiledAutomaton& first, const CompiledAutomaton& second,
+                                                   const set<string>& letters) {
+    vector<vector<unsigned char>> result;
+    map<pair<int32_t, int32_t>, size_t> classes;
+    for (const auto& letter: letters) {
+        auto byte = static_cast<unsigned char>(letter[0]);
+        auto [iter, is_new] = classes.emplace(pair(first.get_byte_class(byte), second.get_byte_class(byte)),
+                                              result.size());
+        if (is_new) {
+            result.emplace_back();
+        }
+        result[iter->second].push_back(byte);
+    }
+    return result;
+}
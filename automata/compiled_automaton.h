@@ -0,0 +1,163 @@
+#ifndef AUTOMATA_COMPILED_AUTOMATON_H
+#define AUTOMATA_COMPILED_AUTOMATON_H
+
+#include "automata.h"
+#include "thread_pool.h"
+#include <array>
+#include <cstdint>
+#include <memory>
+
+
+class bad_automaton_file_exception: std::exception{
+    [[nodiscard]] const char* what() const noexcept override;
+};
+
+class automaton_write_exception: std::exception{
+    [[nodiscard]] const char* what() const noexcept override;
+};
+
+
+// ДКА в виде плоской таблицы: table[state * width + symbol] - следующее состояние или DEAD_STATE.
+// Столбцы таблицы - классы байтов: байты с одинаковыми переходами из всех состояний (в том числе
+// байты не из алфавита, которые всегда ведут в DEAD_STATE) получают один столбец,
+// поэтому шаг по любому байту - это одно обращение к symbol_by_byte и одно к table.
+// Вместо плотной таблицы можно выбрать упаковку строк со сдвигом (TableLayout::row_displacement):
+// строки состояний накладываются друг на друга в одном массиве, строка состояния s начинается с base[s],
+// а check[base[s] + symbol] == s отличает свой переход от чужого. Переходы в DEAD_STATE не хранятся,
+// поэтому разреженная таблица занимает меньше памяти, а шаг остаётся O(1) - на одно обращение больше.
+// Номера шаблонов принимающих состояний (см. pattern_union) хранятся пулом: одинаковые наборы номеров
+// хранятся один раз, у состояния - только номер набора (0 - пустой набор).
+// Таблица, маска принимающих состояний и пул лежат либо в собственном буфере, либо прямо в отображённом
+// в память файле (см. save/load); storage держит то, в чём они лежат, и общий для копий объекта
+enum class TableLayout{
+    dense,
+    row_displacement
+};
+
+
+class CompiledAutomaton{
+public:
+    static constexpr int32_t DEAD_STATE = -1;
+    static constexpr size_t LANES = 16;  // сколько слов одновременно ведёт accepts_interleaved
+    static constexpr uint32_t FORMAT_VERSION = 3;
+
+private:
+    size_t state_number;
+    size_t width;
+    int32_t start_state;
+    std::array<int32_t, 256> symbol_by_byte;
+    const int32_t* table;              // для row_displacement - упакованные строки
+    const int32_t* base;               // nullptr для плотной таблицы
+    const int32_t* check;
+    size_t packed_size;
+    const unsigned long long* accept;
+    size_t id_set_number;
+    size_t id_number;
+    const uint32_t* id_set_by_state;   // номер набора номеров шаблонов для каждого состояния
+    const uint32_t* id_set_start;      // набор k - ids[id_set_start[k]...id_set_start[k + 1]]
+    const uint32_t* ids;
+    std::shared_ptr<const void> storage;
+
+    CompiledAutomaton(): state_number(0), width(0), start_state(DEAD_STATE), symbol_by_byte(), table(nullptr), base(nullptr),
+                         check(nullptr), packed_size(0), accept(nullptr),
+                         id_set_number(0), id_number(0), id_set_by_state(nullptr), id_set_start(nullptr), ids(nullptr) {}
+
+public:
+    explicit CompiledAutomaton(const Automaton&, TableLayout layout = TableLayout::dense);
+    // Детерминизирует копию автомата и компилирует её
+    static CompiledAutomaton determinized(Automaton automaton);
+
+    // Двоичный формат: заголовок, symbol_by_byte, таблица и маска, всё выровнено по 8 байт и адресуется
+    // смещениями от начала файла. load отображает файл в память и ничего не копирует, но проверяет
+    // все таблицы одним проходом, так что шаги по загруженному автомату не выходят за его массивы
+    void save(const string& path) const;
+    static CompiledAutomaton load(const string& path);
+
+    [[nodiscard]] const size_t& get_state_number() const;
+    [[nodiscard]] const size_t& get_class_number() const;
+    [[nodiscard]] const int32_t& get_start_state() const;
+    [[nodiscard]] TableLayout get_layout() const;
+    // сколько байт занимают переходы (без symbol_by_byte и маски принимающих)
+    [[nodiscard]] size_t get_table_bytes() const;
+
+    [[nodiscard]] const int32_t& get_byte_class(const unsigned char& byte) const {
+        return symbol_by_byte[byte];
+    }
+
+    // Из DEAD_STATE переходов нет: возвращается DEAD_STATE
+    [[nodiscard]] int32_t step(const int32_t& state, const unsigned char& byte) const {
+        if (state == DEAD_STATE) {
+            return DEAD_STATE;
+        }
+        if (base == nullptr) {
+            return table[state * width + symbol_by_byte[byte]];
+        }
+        size_t index = base[state] + symbol_by_byte[byte];
+        return check[index] == state ? table[index] : DEAD_STATE;
+    }
+
+    [[nodiscard]] bool is_accept(const int32_t& state) const {
+        return (accept[state / 64] >> (state % 64)) & 1ull;
+    }
+
+    // номера шаблонов состояния по возрастанию: [first, second)
+    [[nodiscard]] pair<const uint32_t*, const uint32_t*> get_accept_ids(const int32_t& state) const {
+        uint32_t id_set = id_set_by_state[state];
+        return {ids + id_set_start[id_set], ids + id_set_start[id_set + 1]};
+    }
+
+    [[nodiscard]] bool accepts(std::string_view word) const;
+
+    // Номера шаблонов, которые принимают слово целиком
+    [[nodiscard]] vector<uint32_t> matching_ids(std::string_view word) const;
+
+    // Поиск в стиле Ахо-Корасик для автомата из pattern_union(..., true): за один проход по тексту
+    // для каждой позиции выдаются (конец вхождения, номер шаблона) всех шаблонов, вхождение которых
+    // там заканчивается. Байт не из алфавита обрывает все вхождения, и чтение начинается заново
+    [[nodiscard]] vector<pair<size_t, uint32_t>> find_pattern_ids(std::string_view text) const;
+
+    // Проверяет все слова в потоках пула. Результат - битовая маска: бит i слова i / 64 отвечает за words[i].
+    // Объект не меняется, поэтому один CompiledAutomaton можно одновременно использовать из любого числа потоков
+    [[nodiscard]] vector<unsigned long long> accepts_batch(const vector<std::string_view>& words, ThreadPool& pool) const;
+
+    // То же в одном потоке, но LANES слов продвигаются по таблице одновременно: переходы разных слов
+    // не зависят друг от друга, и процессор может ждать несколько обращений к памяти сразу
+    [[nodiscard]] vector<unsigned long long> accepts_interleaved(const vector<std::string_view>& words) const;
+
+    // Одно длинное слово в потоках пула. Текст делится на куски по числу потоков; каждый кусок, кроме первого,
+    // читается сразу из всех состояний, и получается отображение "состояние в начале -> состояние в конце".
+    // Дорожки, пришедшие в одно состояние, дальше идут вместе, так что у минимального ДКА после короткого
+    // начала кусок обычно читается одной-двумя дорожками. Затем отображения применяются по порядку к start_state.
+    // Если состояний слишком много для куска или дорожки не сходятся (счётчики, перестановки), кусок читается
+    // по порядку, когда до него дойдёт очередь, - тогда выигрыша нет, но и не хуже последовательного accepts
+    [[nodiscard]] int32_t run_parallel(std::string_view text, ThreadPool& pool) const;
+    [[nodiscard]] bool accepts_parallel(std::string_view text, ThreadPool& pool) const;
+
+    // Строки текста (разделённые '\n') проверяются целиком. Текст делится на куски по границам строк,
+    // куски обрабатываются в потоках пула; удобно вызывать от MappedFile::view()
+    [[nodiscard]] size_t count_matching_lines(std::string_view text, ThreadPool& pool) const;
+    [[nodiscard]] vector<size_t> matching_line_offsets(std::string_view text, ThreadPool& pool) const;
+
+private:
+    template<typename OnMatch>
+    void _scan_lines(std::string_view text, size_t begin, size_t end, OnMatch&& on_match) const;
+    [[nodiscard]] vector<size_t> _split_by_lines(std::string_view text, size_t chunk_number) const;
+    [[nodiscard]] int32_t _run(int32_t state, std::string_view text) const;
+    // Пустой результат - догадка не удалась, кусок надо читать из известного состояния
+    [[nodiscard]] vector<int32_t> _chunk_mapping(std::string_view chunk) const;
+
+    void _accepts_interleaved(const std::string_view* words, size_t begin, size_t end,
+                              vector<unsigned long long>& result) const;
+    template<typename Lookup>
+    void _accepts_interleaved(const std::string_view* words, size_t begin, size_t end,
+                              vector<unsigned long long>& result, Lookup&& lookup) const;
+    void _pack_rows(vector<int32_t>& dense, vector<int32_t>& owned_base, vector<int32_t>& owned_check);
+};
+
+
+// Буквы (байты из letters), разбитые на классы: в одном классе буквы, которые и в first, и в second
+// попадают в одинаковые столбцы таблицы. Нужны, чтобы обходить пары состояний по одной букве из класса
+vector<vector<unsigned char>> joint_letter_classes(const CompiledAutomaton& first, const CompiledAutomaton& second,
+                                                   const set<string>& letters);
+
+#endif //AUTOMATA_COMPILED_AUTOMATON_H
@@ -0,0 +1,106 @@
+#include "dictionary_builder.h"
+
+[[nodiscard]] const char* unsorted_words_exception::what() const noexcept {
+    return "Words have to be added in sorted order!\n";
+}
+
+
+
+//DictionaryBuilder
+
+DictionaryBuilder::DictionaryBuilder() {
+    path.push_back(_new_node());
+}
+
+size_t DictionaryBuilder::_new_node() {
+    if (!free_nodes.empty()) {
+        size_t node = free_nodes.back();
+        free_nodes.pop_back();
+        nodes[node] = _Node();
+        return node;
+    }
+    nodes.emplace_back();
+    return nodes.size() - 1;
+}
+
+string DictionaryBuilder::_signature(const size_t& node) const {
+    string signature(1, nodes[node].is_accept ? '1' : '0');
+    for (const auto& [letter, child]: nodes[node].children) {
+        signature += letter;
+        signature.append(reinterpret_cast<const char*>(&child), sizeof(child));
+    }
+    return signature;
+}
+
+// Регистрирует узлы пути глубже prefix_length, заменяя их уже известными эквивалентными узлами
+void DictionaryBuilder::_replace_or_register(const size_t& prefix_length) {
+    while (path.size() > prefix_length + 1) {
+        size_t child = path.back();
+        path.pop_back();
+        size_t parent = path.back();
+        auto [iter, is_new] = registered.emplace(_signature(child), child);
+        if (!is_new) {
+            nodes[parent].children.back().second = iter->second;
+            free_nodes.push_back(child);
+        }
+    }
+}
+
+void DictionaryBuilder::add(std::string_view word) {
+    if (has_words && word <= previous_word) {
+        if (word == previous_word) {
+            return;
+        }
+        throw unsorted_words_exception();
+    }
+    size_t prefix_length = 0;
+    while (prefix_length < word.size() && prefix_length < previous_word.size() &&
+           word[prefix_length] == previous_word[prefix_length]) {
+        ++prefix_length;
+    }
+    _replace_or_register(prefix_length);
+    for (size_t i = prefix_length; i < word.size(); ++i) {
+        size_t node = _new_node();
+        nodes[path.back()].children.emplace_back(word[i], node);
+        path.push_back(node);
+    }
+    nodes[path.back()].is_accept = true;
+    previous_word = word;
+    has_words = true;
+}
+
+Automaton DictionaryBuilder::finish() {
+    _replace_or_register(0);
+    size_t root = path.front();
+
+    // нумерация обходом в ширину от корня: освобождённые узлы в автомат не попадают
+    std::unordered_map<size_t, size_t> renumeration = {{root, 0}};
+    vector<size_t> order = {root};
+    for (size_t current = 0; current < order.size(); ++current) {
+        for (const auto& [letter, child]: nodes[order[current]].children) {
+            if (renumeration.emplace(child, order.size()).second) {
+                order.push_back(child);
+            }
+        }
+    }
+    vector<State> st;
+    vector<set<Transition>> tr(order.size());
+    for (size_t current = 0; current < order.size(); ++current) {
+        st.emplace_back(std::to_string(current), current == 0, nodes[order[current]].is_accept);
+        for (const auto& [letter, child]: nodes[order[current]].children) {
+            tr[current].emplace(string(1, letter), renumeration[child]);
+        }
+    }
+
+    nodes.clear();
+    free_nodes.clear();
+    registered.clear();
+    path.assign(1, _new_node());
+    previous_word.clear();
+    has_words = false;
+    return Automaton::_from_dfa(st, tr);
+}
+
+size_t DictionaryBuilder::get_node_number() const {
+    return nodes.size() - free_nodes.size();
+}
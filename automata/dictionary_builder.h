@@ -0,0 +1,43 @@
+#ifndef AUTOMATA_DICTIONARY_BUILDER_H
+#define AUTOMATA_DICTIONARY_BUILDER_H
+
+#include "automata.h"
+
+
+class unsorted_words_exception: std::exception{
+    [[nodiscard]] const char* what() const noexcept override;
+};
+
+
+// Построение минимального ациклического ДКА по отсортированному списку слов (Daciuk и др., 2000).
+// После каждого слова минимальна вся часть автомата, кроме пути последнего слова, поэтому
+// в памяти держится только минимальный автомат, а не бор всех слов
+class DictionaryBuilder{
+    struct _Node{
+        bool is_accept = false;
+        vector<pair<char, size_t>> children;  // по возрастанию букв, последний ребёнок - на пути последнего слова
+    };
+
+    vector<_Node> nodes;
+    vector<size_t> free_nodes;
+    std::unordered_map<string, size_t> registered;  // сигнатура узла -> узел
+    vector<size_t> path;                             // узлы последнего слова, ещё не зарегистрированные
+    string previous_word;
+    bool has_words = false;
+
+public:
+    DictionaryBuilder();
+
+    void add(std::string_view word);
+    // После finish строитель можно использовать заново
+    Automaton finish();
+
+    [[nodiscard]] size_t get_node_number() const;
+
+private:
+    size_t _new_node();
+    [[nodiscard]] string _signature(const size_t& node) const;
+    void _replace_or_register(const size_t& prefix_length);
+};
+
+#endif //AUTOMATA_DICTIONARY_BUILDER_H
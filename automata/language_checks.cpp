@@ -0,0 +1,296 @@
+#include "language_checks.h"
+#include "compiled_automaton.h"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <numeric>
+
+
+// Система непересекающихся множеств с эвристикой по рангу и сжатием путей
+class _DisjointSets{
+    vector<size_t> parent;
+    vector<unsigned char> rank;
+
+public:
+    explicit _DisjointSets(const size_t& size): parent(size), rank(size, 0) {
+        std::iota(parent.begin(), parent.end(), 0);
+    }
+
+    size_t find(size_t x) {
+        while (parent[x] != x) {
+            parent[x] = parent[parent[x]];
+            x = parent[x];
+        }
+        return x;
+    }
+
+    bool unite(size_t x, size_t y) {
+        x = find(x);
+        y = find(y);
+        if (x == y) {
+            return false;
+        }
+        if (rank[x] < rank[y]) {
+            std::swap(x, y);
+        }
+        parent[y] = x;
+        rank[x] += rank[x] == rank[y];
+        return true;
+    }
+};
+
+
+LanguageCheckResult equivalent(const Automaton& first_automaton, const Automaton& second_automaton) {
+    const auto first = CompiledAutomaton::determinized(first_automaton);
+    const auto second = CompiledAutomaton::determinized(second_automaton);
+    set<string> letters = first_automaton.get_alphabet();
+    letters.insert(second_automaton.get_alphabet().begin(), second_automaton.get_alphabet().end());
+    auto classes = joint_letter_classes(first, second, letters);
+
+    // DEAD_STATE каждого автомата - отдельный элемент (последний в его половине)
+    const size_t first_size = first.get_state_number() + 1;
+    const size_t second_size = second.get_state_number() + 1;
+    auto first_index = [&](const int32_t& state) {
+        return state == CompiledAutomaton::DEAD_STATE ? first_size - 1 : static_cast<size_t>(state);
+    };
+    auto second_index = [&](const int32_t& state) {
+        return first_size + (state == CompiledAutomaton::DEAD_STATE ? second_size - 1 : static_cast<size_t>(state));
+    };
+    auto first_accept = [&](const int32_t& state) {
+        return state != CompiledAutomaton::DEAD_STATE && first.is_accept(state);
+    };
+    auto second_accept = [&](const int32_t& state) {
+        return state != CompiledAutomaton::DEAD_STATE && second.is_accept(state);
+    };
+
+    struct Pair{
+        int32_t first, second;
+        size_t parent;
+        unsigned char byte;
+    };
+    vector<Pair> pairs = {{first.get_start_state(), second.get_start_state(), SIZE_MAX, 0}};
+    _DisjointSets sets(first_size + second_size);
+    sets.unite(first_index(pairs[0].first), second_index(pairs[0].second));
+
+    for (size_t current = 0; current < pairs.size(); ++current) {
+        auto [p, q, parent, byte] = pairs[current];
+        if (first_accept(p) != second_accept(q)) {
+            string witness;
+            for (size_t i = current; pairs[i].parent != SIZE_MAX; i = pairs[i].parent) {
+                witness += static_cast<char>(pairs[i].byte);
+            }
+            std::reverse(witness.begin(), witness.end());
+            return {false, witness};
+        }
+        if (p == CompiledAutomaton::DEAD_STATE && q == CompiledAutomaton::DEAD_STATE) {
+            continue;
+        }
+        for (const auto& letter_class: classes) {
+            unsigned char letter = letter_class[0];
+            int32_t next_p = p == CompiledAutomaton::DEAD_STATE ? p : first.step(p, letter);
+            int32_t next_q = q == CompiledAutomaton::DEAD_STATE ? q : second.step(q, letter);
+            if (sets.unite(first_index(next_p), second_index(next_q))) {
+                pairs.push_back({next_p, next_q, current, letter});
+            }
+        }
+    }
+    return {true, ""};
+}
+
+
+// Переходы НКА по номерам букв (общим для обоих автоматов)
+static vector<vector<vector<size_t>>> _transitions_by_letter(const Automaton& automaton,
+                                                              const std::array<int32_t, 256>& letter_by_byte,
+                                                              const size_t& letter_number) {
+    vector<vector<vector<size_t>>> result(automaton.get_states().size(), vector<vector<size_t>>(letter_number));
+    for (size_t i = 0; i < result.size(); ++i) {
+        for (const auto& transition: automaton.get_transitions()[i]) {
+            int32_t letter = letter_by_byte[static_cast<unsigned char>(transition.get_expr()[0])];
+            if (letter >= 0) {
+                result[i][letter].push_back(transition.get_finish());
+            }
+        }
+    }
+    return result;
+}
+
+// simulated_by[x] - состояния y, прямо симулирующие x: y принимающее, если x принимающее, и на любой
+// переход x по букве y отвечает переходом по той же букве в состояние, симулирующее цель.
+// Для больших автоматов считать квадратное отношение дорого - тогда берётся тождественное
+static vector<_Bitset> _direct_simulation(const Automaton& automaton, const vector<vector<vector<size_t>>>& delta) {
+    static const size_t MAX_SIMULATION_SIZE = 2048;
+    const size_t n = delta.size();
+    vector<_Bitset> simulated_by(n, _Bitset(n));
+    if (n > MAX_SIMULATION_SIZE) {
+        for (size_t x = 0; x < n; ++x) {
+            simulated_by[x].set(x);
+        }
+        return simulated_by;
+    }
+    const auto& states = automaton.get_states();
+    for (size_t x = 0; x < n; ++x) {
+        for (size_t y = 0; y < n; ++y) {
+            bool possible = !states[x].get_is_accept() || states[y].get_is_accept();
+            for (size_t letter = 0; possible && letter < delta[x].size(); ++letter) {
+                possible = delta[x][letter].empty() || !delta[y][letter].empty();
+            }
+            if (possible) {
+                simulated_by[x].set(y);
+            }
+        }
+    }
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (size_t x = 0; x < n; ++x) {
+            _Bitset refined(n);
+            simulated_by[x].for_each([&](size_t y) {
+                bool simulates = true;
+                for (size_t letter = 0; simulates && letter < delta[x].size(); ++letter) {
+                    for (const size_t& x_next: delta[x][letter]) {
+                        bool answered = false;
+                        for (const size_t& y_next: delta[y][letter]) {
+                            if (simulated_by[x_next].test(y_next)) {
+                                answered = true;
+                                break;
+                            }
+                        }
+                        if (!answered) {
+                            simulates = false;
+                            break;
+                        }
+                    }
+                }
+                if (simulates) {
+                    refined.set(y);
+                }
+            });
+            if (refined != simulated_by[x]) {
+                simulated_by[x] = std::move(refined);
+                changed = true;
+            }
+        }
+    }
+    return simulated_by;
+}
+
+LanguageCheckResult is_included(const Automaton& smaller_automaton, const Automaton& larger_automaton) {
+    Automaton smaller = smaller_automaton;
+    Automaton larger = larger_automaton;
+    smaller.make_one_letter();
+    larger.make_one_letter();
+    if (smaller.get_start_state() >= smaller.get_states().size()) {
+        return {true, ""};
+    }
+
+    // буквы - алфавит smaller: других букв в словах из L(smaller) нет
+    std::array<int32_t, 256> letter_by_byte{};
+    letter_by_byte.fill(-1);
+    const auto& letters = smaller.get_letters();
+    for (size_t letter = 0; letter < letters.size(); ++letter) {
+        letter_by_byte[static_cast<unsigned char>(letters[letter][0])] = letter;
+    }
+    auto smaller_delta = _transitions_by_letter(smaller, letter_by_byte, letters.size());
+    auto larger_delta = _transitions_by_letter(larger, letter_by_byte, letters.size());
+    auto simulated_by = _direct_simulation(larger, larger_delta);
+    const size_t larger_size = larger_delta.size();
+    _Bitset larger_accept(larger_size);
+    for (size_t i = 0; i < larger_size; ++i) {
+        if (larger.get_states()[i].get_is_accept()) {
+            larger_accept.set(i);
+        }
+    }
+
+    struct Node{
+        size_t state;
+        _Bitset subset;
+        size_t parent;
+        unsigned char byte;
+        bool removed;
+    };
+    vector<Node> nodes;
+    vector<vector<size_t>> antichain(smaller_delta.size());
+
+    // subset "не лучше" other для поиска контрпримера: каждое состояние subset симулируется кем-то из other
+    auto covered = [&](const _Bitset& subset, const _Bitset& other) {
+        bool result = true;
+        subset.for_each([&](size_t t) {
+            if (!result) {
+                return;
+            }
+            bool found = false;
+            for (size_t w = 0; w < other.get_words().size() && !found; ++w) {
+                found = (other.get_words()[w] & simulated_by[t].get_words()[w]) != 0;
+            }
+            result = found;
+        });
+        return result;
+    };
+    auto add = [&](const size_t& state, _Bitset subset, const size_t& parent, const unsigned char& byte) {
+        for (const size_t& index: antichain[state]) {
+            if (!nodes[index].removed && covered(nodes[index].subset, subset)) {
+                return;
+            }
+        }
+        vector<size_t> kept;
+        for (const size_t& index: antichain[state]) {
+            if (!nodes[index].removed && covered(subset, nodes[index].subset)) {
+                nodes[index].removed = true;
+            } else if (!nodes[index].removed) {
+                kept.push_back(index);
+            }
+        }
+        kept.push_back(nodes.size());
+        antichain[state] = std::move(kept);
+        nodes.push_back({state, std::move(subset), parent, byte, false});
+    };
+
+    _Bitset start_subset(larger_size);
+    if (larger.get_start_state() < larger_size) {
+        start_subset.set(larger.get_start_state());
+    }
+    add(smaller.get_start_state(), std::move(start_subset), SIZE_MAX, 0);
+
+    for (size_t current = 0; current < nodes.size(); ++current) {
+        if (nodes[current].removed) {
+            continue;
+        }
+        size_t state = nodes[current].state;
+        bool larger_accepts = false;
+        for (size_t w = 0; w < nodes[current].subset.get_words().size() && !larger_accepts; ++w) {
+            larger_accepts = (nodes[current].subset.get_words()[w] & larger_accept.get_words()[w]) != 0;
+        }
+        if (smaller.get_states()[state].get_is_accept() && !larger_accepts) {
+            string witness;
+            for (size_t i = current; nodes[i].parent != SIZE_MAX; i = nodes[i].parent) {
+                witness += static_cast<char>(nodes[i].byte);
+            }
+            std::reverse(witness.begin(), witness.end());
+            return {false, witness};
+        }
+        for (size_t letter = 0; letter < letters.size(); ++letter) {
+            if (smaller_delta[state][letter].empty()) {
+                continue;
+            }
+            _Bitset next_subset(larger_size);
+            nodes[current].subset.for_each([&](size_t s) {
+                for (const size_t& next: larger_delta[s][letter]) {
+                    next_subset.set(next);
+                }
+            });
+            for (const size_t& next_state: smaller_delta[state][letter]) {
+                add(next_state, next_subset, current, static_cast<unsigned char>(letters[letter][0]));
+            }
+        }
+    }
+    return {true, ""};
+}
+
+LanguageCheckResult is_universal(const Automaton& automaton) {
+    vector<State> st = {State("all", true, true)};
+    vector<set<Transition>> tr(1);
+    for (const auto& letter: automaton.get_alphabet()) {
+        tr[0].emplace(letter, 0);
+    }
+    return is_included(Automaton(st, tr), automaton);
+}
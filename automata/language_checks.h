@@ -0,0 +1,28 @@
+#ifndef AUTOMATA_LANGUAGE_CHECKS_H
+#define AUTOMATA_LANGUAGE_CHECKS_H
+
+#include "automata.h"
+
+
+// Результат проверки свойства языков; если свойство не выполнено, witness - слово, на котором это видно
+struct LanguageCheckResult{
+    bool holds;
+    string witness;
+};
+
+
+// L(first) = L(second). Алгоритм Хопкрофта-Карпа: пары состояний детерминизированных автоматов
+// склеиваются через систему непересекающихся множеств, минимизация и пополнение не нужны.
+// witness - кратчайшее из найденных слов, которое принимает ровно один из автоматов
+LanguageCheckResult equivalent(const Automaton& first, const Automaton& second);
+
+// L(smaller) ⊆ L(larger) прямо на НКА (после make_one_letter), без детерминизации larger.
+// Обход пар (состояние smaller, подмножество состояний larger) с отсечением по антицепям: пара
+// не раскрывается, если уже есть пара с тем же состоянием и подмножеством, которое "не лучше"
+// по отношению прямой симуляции в larger. witness - слово из L(smaller), которого нет в L(larger)
+LanguageCheckResult is_included(const Automaton& smaller, const Automaton& larger);
+
+// L(automaton) - все слова над его алфавитом; witness - непринимаемое слово
+LanguageCheckResult is_universal(const Automaton& automaton);
+
+#endif //AUTOMATA_LANGUAGE_CHECKS_H
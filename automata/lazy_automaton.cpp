@@ -0,0 +1,126 @@
+#include "lazy_automaton.h"
+
+LazyAutomaton::LazyAutomaton(Automaton automaton, size_t max_states):
+        letter_number(automaton.get_letters().size()),
+        max_states(std::max<size_t>(max_states, 1)) {
+    automaton.make_one_letter();
+    const auto& states = automaton.get_states();
+    const auto& transitions = automaton.get_transitions();
+
+    letter_by_byte.fill(DEAD_STATE);
+    for (size_t letter = 0; letter < letter_number; ++letter) {
+        letter_by_byte[static_cast<unsigned char>(automaton.get_letters()[letter][0])] = letter;
+    }
+    nfa_transitions.resize(states.size());
+    nfa_accept.resize(states.size());
+    vector<vector<size_t>> reverse_transitions(states.size());
+    for (size_t i = 0; i < states.size(); ++i) {
+        nfa_accept[i] = states[i].get_is_accept();
+        for (const auto& transition: transitions[i]) {
+            nfa_transitions[i].emplace_back(automaton.get_letter_id(transition.get_expr()), transition.get_finish());
+            reverse_transitions[transition.get_finish()].push_back(i);
+        }
+    }
+    // обратный обход от принимающих состояний
+    nfa_live = nfa_accept;
+    vector<size_t> queue;
+    for (size_t i = 0; i < states.size(); ++i) {
+        if (nfa_live[i]) {
+            queue.push_back(i);
+        }
+    }
+    for (size_t i = 0; i < queue.size(); ++i) {
+        for (const auto& from: reverse_transitions[queue[i]]) {
+            if (!nfa_live[from]) {
+                nfa_live[from] = true;
+                queue.push_back(from);
+            }
+        }
+    }
+    start_subset = _Bitset(states.size());
+    if (automaton.get_start_state() < states.size() && nfa_live[automaton.get_start_state()]) {
+        start_subset.set(automaton.get_start_state());
+    }
+}
+
+void LazyAutomaton::_flush() {
+    cache.clear();
+    subsets.clear();
+    table.clear();
+    accept.clear();
+    start_state = UNKNOWN_STATE;
+    ++flush_number;
+}
+
+int32_t LazyAutomaton::_intern(_Bitset subset) {
+    if (subset.none()) {
+        return DEAD_STATE;
+    }
+    auto found = cache.find(subset);
+    if (found != cache.end()) {
+        return found->second;
+    }
+    if (subsets.size() >= max_states) {
+        _flush();
+    }
+    bool is_accept = false;
+    subset.for_each([&](size_t i) { is_accept = is_accept || nfa_accept[i]; });
+    auto [iter, is_new] = cache.emplace(std::move(subset), static_cast<int32_t>(subsets.size()));
+    subsets.push_back(&iter->first);
+    table.resize(table.size() + letter_number, UNKNOWN_STATE);
+    accept.push_back(is_accept);
+    return iter->second;
+}
+
+int32_t LazyAutomaton::_compute_transition(const int32_t& state, const size_t& letter) {
+    _Bitset next(nfa_transitions.size());
+    subsets[state]->for_each([&](size_t i) {
+        for (const auto& [transition_letter, finish]: nfa_transitions[i]) {
+            if (transition_letter == letter && nfa_live[finish]) {
+                next.set(finish);
+            }
+        }
+    });
+    size_t flushes = flush_number;
+    int32_t result = _intern(std::move(next));
+    if (flushes == flush_number) {  // иначе строки state уже нет
+        table[state * letter_number + letter] = result;
+    }
+    return result;
+}
+
+int32_t LazyAutomaton::get_start_state() {
+    if (start_state == UNKNOWN_STATE) {
+        start_state = _intern(start_subset);
+    }
+    return start_state;
+}
+
+int32_t LazyAutomaton::step(const int32_t& state, const unsigned char& byte) {
+    int32_t letter = letter_by_byte[byte];
+    if (state == DEAD_STATE || letter == DEAD_STATE) {
+        return DEAD_STATE;
+    }
+    int32_t next = table[state * letter_number + letter];
+    return (next != UNKNOWN_STATE) ? next : _compute_transition(state, letter);
+}
+
+bool LazyAutomaton::is_accept(const int32_t& state) const {
+    return state != DEAD_STATE && accept[state];
+}
+
+bool LazyAutomaton::accepts(std::string_view word) {
+    int32_t state = get_start_state();
+    for (size_t i = 0; i < word.size() && state != DEAD_STATE; ++i) {
+        state = step(state, static_cast<unsigned char>(word[i]));
+    }
+    return is_accept(state);
+}
+
+size_t LazyAutomaton::get_cached_state_number() const {
+    return subsets.size();
+}
+
+const size_t& LazyAutomaton::get_flush_number() const {
+    return flush_number;
+}
@@ -0,0 +1,55 @@
+#ifndef AUTOMATA_LAZY_AUTOMATON_H
+#define AUTOMATA_LAZY_AUTOMATON_H
+
+#include "automata.h"
+#include <cstdint>
+
+
+// ДКА, который строится по ходу чтения слов: состояние ДКА (подмножество состояний НКА) и переход
+// из него создаются, только когда вход до них дошёл. Созданные состояния лежат в кэше не больше
+// чем на max_states состояний; когда кэш заполнен, он целиком сбрасывается и строится заново.
+// Состояния НКА, из которых принимающее недостижимо, в подмножества не попадают, поэтому
+// DEAD_STATE - ровно те подмножества, из которых слово уже не примется.
+// Объект меняет свой кэш при проверке слов, поэтому из нескольких потоков нужны отдельные копии
+class LazyAutomaton{
+public:
+    static constexpr int32_t DEAD_STATE = -1;
+    static constexpr int32_t UNKNOWN_STATE = -2;
+
+private:
+    vector<vector<pair<size_t, size_t>>> nfa_transitions;  // (номер буквы, куда) после make_one_letter
+    vector<bool> nfa_accept;
+    vector<bool> nfa_live;  // из состояния достижимо принимающее
+    std::array<int32_t, 256> letter_by_byte;
+    size_t letter_number;
+    size_t max_states;
+
+    _Bitset start_subset;
+    int32_t start_state = UNKNOWN_STATE;
+    std::unordered_map<_Bitset, int32_t, _BitsetHash> cache;
+    vector<const _Bitset*> subsets;
+    vector<int32_t> table;  // subsets.size() * letter_number, UNKNOWN_STATE - переход ещё не считали
+    vector<bool> accept;
+    size_t flush_number = 0;
+
+public:
+    LazyAutomaton() = delete;
+    explicit LazyAutomaton(Automaton automaton, size_t max_states = 10000);
+
+    bool accepts(std::string_view word);
+
+    // Пошаговый обход; номера состояний не меняются, пока кэш не сбрасывался
+    int32_t get_start_state();
+    int32_t step(const int32_t& state, const unsigned char& byte);
+    [[nodiscard]] bool is_accept(const int32_t& state) const;
+
+    [[nodiscard]] size_t get_cached_state_number() const;
+    [[nodiscard]] const size_t& get_flush_number() const;
+
+private:
+    int32_t _intern(_Bitset subset);
+    int32_t _compute_transition(const int32_t& state, const size_t& letter);
+    void _flush();
+};
+
+#endif //AUTOMATA_LAZY_AUTOMATON_H
@@ -8,9 +8,6 @@ Automaton input_automata(){
     size_t size, trans_number;
     std::cout << "\n Input number of states: \n";
     std::cin >> size;
-    if(size > 60){
-        throw too_many_states_exception();
-    }
     std::cout << "\n Input states in format \"[name] [start or not (0 or 1)] [accept or not (0 or 1)]\"\n"
                  "(example \"А 1 0\" - state A, start and not accept): \n";
     vector<State> st;
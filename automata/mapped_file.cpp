@@ -0,0 +1,52 @@
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+[[nodiscard]] const char* file_mapping_exception::what() const noexcept {
+    return "Can't map file into memory!\n";
+}
+
+
+
+//MappedFile
+
+MappedFile::MappedFile(const std::string& path) {
+    int descriptor = open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        throw file_mapping_exception();
+    }
+    struct stat info{};
+    if (fstat(descriptor, &info) != 0) {
+        close(descriptor);
+        throw file_mapping_exception();
+    }
+    size = info.st_size;
+    if (size != 0) {  // mmap не умеет отображать пустой файл
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (mapping == MAP_FAILED) {
+            close(descriptor);
+            throw file_mapping_exception();
+        }
+        madvise(mapping, size, MADV_SEQUENTIAL);
+        data = static_cast<const char*>(mapping);
+    }
+    close(descriptor);
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept: data(other.data), size(other.size) {
+    other.data = nullptr;
+    other.size = 0;
+}
+
+MappedFile::~MappedFile() {
+    if (data) {
+        munmap(const_cast<char*>(data), size);
+    }
+}
+
+std::string_view MappedFile::view() const {
+    return {data, size};
+}
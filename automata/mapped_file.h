@@ -0,0 +1,30 @@
+#ifndef AUTOMATA_MAPPED_FILE_H
+#define AUTOMATA_MAPPED_FILE_H
+
+#include <exception>
+#include <string>
+#include <string_view>
+
+
+class file_mapping_exception: std::exception{
+    [[nodiscard]] const char* what() const noexcept override;
+};
+
+
+// Файл, отображённый в память только для чтения. Содержимое доступно через view() без копирования
+class MappedFile{
+    const char* data = nullptr;
+    size_t size = 0;
+
+public:
+    MappedFile() = delete;
+    explicit MappedFile(const std::string& path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&&) noexcept;
+    ~MappedFile();
+
+    [[nodiscard]] std::string_view view() const;
+};
+
+#endif //AUTOMATA_MAPPED_FILE_H
@@ -0,0 +1,33 @@
+#include "multi_pattern.h"
+
+Automaton pattern_union(const vector<Automaton>& patterns, bool unanchored) {
+    vector<State> st = {State("start", true, false)};
+    vector<set<Transition>> tr(1);
+    set<string> alphabet;
+    for (size_t id = 0; id < patterns.size(); ++id) {
+        const auto& pattern = patterns[id];
+        const size_t offset = st.size();
+        for (const auto& state: pattern.get_states()) {
+            st.emplace_back(state.get_name(), false, false);
+            if (state.get_is_accept()) {
+                st.back().add_accept_ids({id});
+            }
+        }
+        for (const auto& state_transitions: pattern.get_transitions()) {
+            tr.emplace_back();
+            for (const auto& transition: state_transitions) {
+                tr.back().emplace(transition.get_expr(), transition.get_finish() + offset);
+            }
+        }
+        if (pattern.get_start_state() < pattern.get_states().size()) {
+            tr[0].emplace("", pattern.get_start_state() + offset);
+        }
+        alphabet.insert(pattern.get_alphabet().begin(), pattern.get_alphabet().end());
+    }
+    if (unanchored) {
+        for (const auto& letter: alphabet) {
+            tr[0].emplace(letter, 0);
+        }
+    }
+    return Automaton(st, tr);
+}
@@ -0,0 +1,15 @@
+#ifndef AUTOMATA_MULTI_PATTERN_H
+#define AUTOMATA_MULTI_PATTERN_H
+
+#include "automata.h"
+
+
+// Объединение шаблонов в один НКА: новое стартовое состояние с пустыми переходами в стартовые
+// состояния шаблонов, принимающие состояния шаблона i помечены номером i (State::get_accept_ids).
+// Номера сохраняются при детерминизации и минимизации, так что после них каждое принимающее
+// состояние знает все шаблоны, которые принимают прочитанное слово.
+// unanchored добавляет в старт петли по всем буквам: тогда автомат принимает слова, которые
+// заканчиваются словом из какого-нибудь шаблона, - для поиска в тексте (CompiledAutomaton::find_pattern_ids)
+Automaton pattern_union(const vector<Automaton>& patterns, bool unanchored = false);
+
+#endif //AUTOMATA_MULTI_PATTERN_H
@@ -0,0 +1,132 @@
+#include "product_automaton.h"
+
+ProductAutomaton::ProductAutomaton(const Automaton& first_automaton, const Automaton& second_automaton,
+                                   ProductOperation operation):
+        first(first_automaton, SIZE_MAX),
+        second(second_automaton, SIZE_MAX),
+        operation(operation) {
+    set<string> alphabet = first_automaton.get_alphabet();
+    alphabet.insert(second_automaton.get_alphabet().begin(), second_automaton.get_alphabet().end());
+    for (const auto& letter: alphabet) {
+        letters.push_back(static_cast<unsigned char>(letter[0]));
+    }
+    _intern({first.get_start_state(), second.get_start_state()}, LazyAutomaton::DEAD_STATE, 0);
+}
+
+bool ProductAutomaton::_is_accept(const pair<int32_t, int32_t>& state) const {
+    bool first_accept = first.is_accept(state.first);
+    bool second_accept = second.is_accept(state.second);
+    switch (operation) {
+        case ProductOperation::intersection:
+            return first_accept && second_accept;
+        case ProductOperation::united:
+            return first_accept || second_accept;
+        case ProductOperation::difference:
+            return first_accept && !second_accept;
+    }
+    return false;
+}
+
+// из такой пары никакое продолжение слова уже не примется: LazyAutomaton отдаёт DEAD_STATE для
+// всех подмножеств, из которых принимающее недостижимо
+bool ProductAutomaton::_is_dead(const pair<int32_t, int32_t>& state) const {
+    bool first_dead = state.first == LazyAutomaton::DEAD_STATE;
+    bool second_dead = state.second == LazyAutomaton::DEAD_STATE;
+    switch (operation) {
+        case ProductOperation::intersection:
+            return first_dead || second_dead;
+        case ProductOperation::united:
+            return first_dead && second_dead;
+        case ProductOperation::difference:
+            return first_dead;
+    }
+    return true;
+}
+
+int32_t ProductAutomaton::_intern(const pair<int32_t, int32_t>& state, const int32_t& from, const size_t& letter) {
+    if (_is_dead(state)) {
+        return LazyAutomaton::DEAD_STATE;
+    }
+    unsigned long long key = (static_cast<unsigned long long>(static_cast<uint32_t>(state.first)) << 32) |
+                             static_cast<uint32_t>(state.second);
+    auto [iter, is_new] = ids.emplace(key, static_cast<int32_t>(product_states.size()));
+    if (is_new) {
+        product_states.push_back(state);
+        parent.emplace_back(from, letter);
+        if (first_accepting == LazyAutomaton::DEAD_STATE && _is_accept(state)) {
+            first_accepting = iter->second;
+        }
+    }
+    return iter->second;
+}
+
+void ProductAutomaton::_expand_next() {
+    auto [p, q] = product_states[expanded];
+    vector<pair<size_t, int32_t>> current_edges;
+    for (size_t letter = 0; letter < letters.size(); ++letter) {
+        int32_t next = _intern({first.step(p, letters[letter]), second.step(q, letters[letter])},
+                               static_cast<int32_t>(expanded), letter);
+        if (next != LazyAutomaton::DEAD_STATE) {
+            current_edges.emplace_back(letter, next);
+        }
+    }
+    edges.push_back(std::move(current_edges));
+    ++expanded;
+}
+
+bool ProductAutomaton::accepts(std::string_view word) {
+    pair<int32_t, int32_t> state = {first.get_start_state(), second.get_start_state()};
+    for (size_t i = 0; i < word.size() && !_is_dead(state); ++i) {
+        state.first = first.step(state.first, static_cast<unsigned char>(word[i]));
+        state.second = second.step(state.second, static_cast<unsigned char>(word[i]));
+    }
+    return _is_accept(state);
+}
+
+// Кратчайшее слово языка произведения: обход в ширину, который останавливается на первой принимающей паре
+std::optional<string> ProductAutomaton::find_word() {
+    while (first_accepting == LazyAutomaton::DEAD_STATE && expanded < product_states.size()) {
+        _expand_next();
+    }
+    if (first_accepting == LazyAutomaton::DEAD_STATE) {
+        return std::nullopt;
+    }
+    string word;
+    for (int32_t state = first_accepting; parent[state].first != LazyAutomaton::DEAD_STATE;
+         state = parent[state].first) {
+        word += static_cast<char>(letters[parent[state].second]);
+    }
+    std::reverse(word.begin(), word.end());
+    return word;
+}
+
+bool ProductAutomaton::is_empty() {
+    return !find_word().has_value();
+}
+
+// Если начальная пара мёртвая, язык пуст: результат - одно непринимающее начальное состояние
+Automaton ProductAutomaton::materialize() {
+    while (expanded < product_states.size()) {
+        _expand_next();
+    }
+    if (product_states.empty()) {
+        return Automaton::_from_dfa({State("-,-", true, false)}, {{}});
+    }
+    vector<State> st;
+    vector<set<Transition>> tr(product_states.size());
+    auto component_name = [](const int32_t& state) {
+        return state == LazyAutomaton::DEAD_STATE ? string("-") : std::to_string(state);
+    };
+    for (size_t i = 0; i < product_states.size(); ++i) {
+        st.emplace_back(component_name(product_states[i].first) + "," + component_name(product_states[i].second),
+                        i == 0, _is_accept(product_states[i]));
+        for (const auto& [letter, next]: edges[i]) {
+            tr[i].emplace(string(1, static_cast<char>(letters[letter])), next);
+        }
+    }
+    return Automaton::_from_dfa(st, tr);
+}
+
+size_t ProductAutomaton::get_built_state_number() const {
+    return product_states.size();
+}
@@ -0,0 +1,55 @@
+#ifndef AUTOMATA_PRODUCT_AUTOMATON_H
+#define AUTOMATA_PRODUCT_AUTOMATON_H
+
+#include "automata.h"
+#include "lazy_automaton.h"
+#include <optional>
+
+
+enum class ProductOperation{
+    intersection,
+    united,
+    difference
+};
+
+
+// Произведение двух автоматов, которое строится по требованию: состояния - пары (p, q) состояний
+// ленивых ДКА операндов (LazyAutomaton, DEAD_STATE - "автомат уже отверг слово"), так что
+// операнды-НКА не детерминизируются целиком - подмножества создаются только для достижимых пар.
+// Пары, в которых нужная операции компонента уже не может дойти до принятия, не создаются;
+// пары, из которых не примется ничего только из-за сочетания компонент, могут остаться.
+// find_word и is_empty останавливаются на первой принимающей паре, materialize достраивает всё
+// достижимое и возвращает обычный Automaton
+class ProductAutomaton{
+    LazyAutomaton first;   // кэш без ограничения: номера состояний хранятся в парах
+    LazyAutomaton second;
+    ProductOperation operation;
+
+    vector<unsigned char> letters;  // буквы произведения - объединение алфавитов
+
+    vector<pair<int32_t, int32_t>> product_states;
+    std::unordered_map<unsigned long long, int32_t> ids;
+    vector<pair<int32_t, size_t>> parent;          // (откуда пришли, номер буквы) - для восстановления слова
+    vector<vector<pair<size_t, int32_t>>> edges;   // переходы раскрытых состояний
+    size_t expanded = 0;
+    int32_t first_accepting = LazyAutomaton::DEAD_STATE;
+
+public:
+    ProductAutomaton() = delete;
+    ProductAutomaton(const Automaton&, const Automaton&, ProductOperation);
+
+    bool accepts(std::string_view word);
+    std::optional<string> find_word();
+    bool is_empty();
+    Automaton materialize();
+
+    [[nodiscard]] size_t get_built_state_number() const;
+
+private:
+    [[nodiscard]] bool _is_accept(const pair<int32_t, int32_t>&) const;
+    [[nodiscard]] bool _is_dead(const pair<int32_t, int32_t>&) const;
+    int32_t _intern(const pair<int32_t, int32_t>&, const int32_t& from, const size_t& letter);
+    void _expand_next();
+};
+
+#endif //AUTOMATA_PRODUCT_AUTOMATON_H
@@ -5,7 +5,22 @@
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
 #include "automata.h"
+#include "compiled_automaton.h"
+#include "mapped_file.h"
+#include "lazy_automaton.h"
+#include "dictionary_builder.h"
+#include "product_automaton.h"
+#include "language_checks.h"
+#include "automaton_stats.h"
+#include "bit_parallel_matcher.h"
+#include "multi_pattern.h"
+#include "test_matcher.h"
 #include <iostream>
+#include <sstream>
+#include <cstring>
+#include <fstream>
+#include <random>
+#include <thread>
 
 TEST(Additional, StateTest){
     State test0("name", true, true);
@@ -54,18 +69,45 @@ TEST(Additional, _MinStateTest){
 }
 
 
+TEST(Additional, _BitsetTest){
+    _Bitset test0(130);
+    _Bitset test1(130);
+    test0.set(0);
+    test0.set(64);
+    test0.set(129);
+    test1.set(3);
+    EXPECT_TRUE(test0.test(64));
+    EXPECT_FALSE(test0.test(63));
+    EXPECT_EQ(test0.count(), 3);
+    EXPECT_FALSE(test0 == test1);
+    EXPECT_NE(_BitsetHash()(test0), _BitsetHash()(test1));
+
+    test1 |= test0;
+    vector<size_t> bits;
+    test1.for_each([&](size_t i) { bits.push_back(i); });
+    EXPECT_EQ(bits, vector<size_t>({0, 3, 64, 129}));
+
+    test1.clear();
+    EXPECT_TRUE(test1.none());
+}
+
+
 TEST(Additional, _DetStateTest){
-    _DetState test0(32+16+1, true, true);
-    _DetState test1(16+2, false, false);
-    _DetState test2(64+8+1, true, true);
+    _DetState test0(100);
+    _DetState test1(100);
+    test0.add(0, false);
+    test0.add(70, true);
+    test1.add(1, false);
 
-    EXPECT_FALSE(test1.get_is_start());
-    EXPECT_TRUE(test2.get_is_accept());
-    EXPECT_EQ((test0|test1).get_mask(), 32+16+2+1);
+    EXPECT_FALSE(test1.get_is_accept());
+    EXPECT_TRUE(test0.get_is_accept());
+    EXPECT_EQ((test0|test1).get_mask().count(), 3);
+    EXPECT_TRUE((test0|test1).get_is_accept());
+    EXPECT_FALSE(test0 == test1);
 
-    EXPECT_TRUE(test0 < test2);
-    EXPECT_TRUE(test1 < test2);
-    EXPECT_TRUE((test1|test0) < test2);
+    test1 |= test0;
+    EXPECT_TRUE(test1.get_mask().test(70));
+    EXPECT_TRUE(test1 == (test0|test1));
 }
 
 TEST(Additional, TransitionTest){
@@ -196,20 +238,1111 @@ TEST(Automata, StartStateNumberLimit){ //
     EXPECT_THROW(Automaton(st, tr), too_many_start_states_exception);
 }
 
-TEST(Automata, StateNumberLimit){ //
+TEST(Automata, MinimizeWithoutStartState){
+    vector<State> st = {State("0", false, false), State("1", false, true)};
+    vector<set<Transition>> tr {{Transition("a", 1)}, {Transition("b", 0)}};
+    Automaton fast(st, tr);
+    Automaton logged(st, tr);
+    fast.minimize();
+    std::stringstream log;
+    logged.minimize(true, log);
+    for (const Automaton* automaton: {&fast, &logged}) {
+        EXPECT_GE(automaton->get_start_state(), automaton->get_states().size());
+        EXPECT_FALSE(automaton->accepts(""));
+        EXPECT_FALSE(automaton->accepts("a"));
+    }
+}
+
+TEST(Automata, DeterminizeWithoutStartState){
+    vector<State> st = {State("0", false, false), State("1", false, true)};
+    vector<set<Transition>> tr {{Transition("a", 1)}, {Transition("", 0)}};
+    Automaton sequential(st, tr);
+    Automaton parallel(st, tr);
+    Automaton partial(st, tr);
+    ThreadPool pool(2);
+    sequential.determinize();
+    parallel.determinize(pool);
+    partial.minimize_partial();
+    for (const Automaton* automaton: {&sequential, &parallel, &partial}) {
+        EXPECT_EQ(automaton->get_states().size(), 0);
+        EXPECT_FALSE(automaton->accepts(""));
+    }
+}
+
+TEST(Automata, FewerTransitionSetsThanStates){ // у последних состояний нет своего множества переходов
     vector<State> st;
     st.emplace_back("0", true, false);
-    for(size_t i = 0; i < 60; ++i){
-        st.emplace_back(std::to_string(i + 1), false, false);
+    for (size_t i = 0; i < 60; ++i) {
+        st.emplace_back(std::to_string(i + 1), false, i == 2);
     }
+    vector<set<Transition>> tr {{Transition("a", 1)},
+                                {Transition("b", 2), Transition("", 0), Transition("ab", 3)},
+                                {Transition("a", 3), Transition("ba", 2)},
+                                {Transition("", 1)}};
+    Automaton test(st, tr);
+    EXPECT_EQ(test.get_transitions().size(), st.size());
+    test.determinize();
+    test.minimize();
+    EXPECT_TRUE(test.accepts("aab"));
+    EXPECT_TRUE(test.accepts("aabab"));
+    EXPECT_FALSE(test.accepts("a"));
+}
+
+TEST(Automata, MinimizeLogMatchesHopcroft){ // задача 1а), семинар 3 и домашнее задание
+    vector<State> st = {State("0", true, true),
+                        State("1", false, false),
+                        State("2", false, false),
+                        State("3", false, false)};
+    vector<set<Transition>> tr {{Transition("a", 1)},
+                                {Transition("b", 2), Transition("", 0), Transition("ab", 3)},
+                                {Transition("a", 3),Transition("ba", 2)},
+                                {Transition("", 1)}};
+    Automaton fast(st, tr);
+    Automaton logged(st, tr);
+    fast.determinize();
+    logged.determinize();
+
+    std::stringstream log;
+    fast.minimize(false);
+    logged.minimize(true, log);
+    EXPECT_FALSE(log.str().empty());
+
+    std::stringstream fast_output, logged_output;
+    fast_output << fast;
+    logged_output << logged;
+    EXPECT_EQ(fast_output.str(), logged_output.str());
+
+    // без принимающих состояний оба способа дают одно непринимающее начальное состояние
+    vector<State> none_st = {State("0", true, false),
+                             State("1", false, false)};
+    vector<set<Transition>> none_tr {{Transition("a", 1)},
+                                     {Transition("a", 0)}};
+    Automaton fast_none(none_st, none_tr);
+    Automaton logged_none(none_st, none_tr);
+    fast_none.minimize(false);
+    logged_none.minimize(true, log);
+    EXPECT_EQ(fast_none.get_state_number(), 1);
+    EXPECT_EQ(logged_none.get_state_number(), 1);
+    EXPECT_EQ(logged_none.get_start_state(), 0);
+    fast_output.str("");
+    logged_output.str("");
+    fast_output << fast_none;
+    logged_output << logged_none;
+    EXPECT_EQ(fast_output.str(), logged_output.str());
+}
+
+TEST(Automata, MinimizeKeepsAcceptDistinction){ // у 0 и 1 одинаковые переходы, но 0 принимающее
+    vector<State> st = {State("0", true, true),
+                        State("1", false, false)};
+    vector<set<Transition>> tr {{Transition("a", 0)},
+                                {Transition("a", 0)}};
+    Automaton fast(st, tr);
+    Automaton logged(st, tr);
+    std::stringstream log;
+    fast.minimize(false);
+    logged.minimize(true, log);
+    EXPECT_EQ(fast.get_state_number(), 2);
+    EXPECT_EQ(logged.get_state_number(), 2);
+}
+
+TEST(Automata, LargeNFADeterminize){ // i -a-> i+1, i -a-> i+2
+    const size_t size = 100;
+    vector<State> st;
+    for(size_t i = 0; i < size; ++i){
+        st.emplace_back(std::to_string(i), i == 0, i + 1 == size);
+    }
+    vector<set<Transition>> tr(size);
+    for(size_t i = 0; i + 1 < size; ++i){
+        tr[i].insert(Transition("a", i + 1));
+        if (i + 2 < size) {
+            tr[i].insert(Transition("a", i + 2));
+        }
+    }
+
+    Automaton test(st, tr);
+    test.determinize();
+    EXPECT_EQ(test.get_state_number(), size);
+    EXPECT_EQ(test.get_transition_number(), size - 1);
+
+    test.minimize(false); // drain + все состояния, из которых достижимо 99 за разное число шагов
+    EXPECT_EQ(test.get_state_number(), size + 1);
+}
+
+TEST(Compiled, TableSteps){ // (a*b*c)*
+    vector<State> st = {State("0", true, true),
+                        State("1", false, false),
+                        State("2", false, false)};
+    vector<set<Transition>> tr {{Transition("a", 0), Transition("", 1)},
+                                {Transition("b", 1), Transition("", 2)},
+                                {Transition("c", 2), Transition("", 0)}};
+    Automaton test(st, tr);
+    EXPECT_THROW(CompiledAutomaton{test}, not_deterministic_exception);
+
+    test.determinize();
+    test.minimize(false);
+    CompiledAutomaton compiled(test);
+    EXPECT_EQ(compiled.get_state_number(), 1);
+    EXPECT_EQ(compiled.get_class_number(), 2); // a, b, c ведут себя одинаково + байты не из алфавита
+
+    int32_t state = compiled.get_start_state();
+    for (char c: string("abcab")) {
+        state = compiled.step(state, c);
+        ASSERT_NE(state, CompiledAutomaton::DEAD_STATE);
+    }
+    EXPECT_TRUE(compiled.is_accept(state));
+    EXPECT_EQ(compiled.step(state, 'x'), CompiledAutomaton::DEAD_STATE);
+}
+
+TEST(Compiled, PartialDFA){
+    vector<State> st = {State("0", true, false),
+                        State("1", false, true)};
+    vector<set<Transition>> tr {{Transition("a", 1)},
+                                {}};
+    Automaton test(st, tr);
+    CompiledAutomaton compiled(test);
+    EXPECT_FALSE(compiled.is_accept(compiled.get_start_state()));
+    EXPECT_TRUE(compiled.is_accept(compiled.step(compiled.get_start_state(), 'a')));
+    EXPECT_EQ(compiled.step(1, 'a'), CompiledAutomaton::DEAD_STATE);
+    EXPECT_EQ(compiled.step(CompiledAutomaton::DEAD_STATE, 'a'), CompiledAutomaton::DEAD_STATE);
+
+    // без стартового состояния и без состояний вовсе
+    vector<std::string_view> words(40, "a");
+    for (const auto& layout: {TableLayout::dense, TableLayout::row_displacement}) {
+        const CompiledAutomaton no_start(Automaton({State("0", false, true)}, {{}}), layout);
+        EXPECT_EQ(no_start.get_start_state(), CompiledAutomaton::DEAD_STATE);
+        EXPECT_FALSE(no_start.accepts("a"));
+        EXPECT_EQ(no_start.accepts_interleaved(words), vector<unsigned long long>({0}));
+
+        const CompiledAutomaton empty(Automaton({}, {}), layout);
+        EXPECT_FALSE(empty.accepts(""));
+        EXPECT_EQ(empty.accepts_interleaved(words), vector<unsigned long long>({0}));
+    }
+}
+
+TEST(Automata, LetterClasses){ // (a|b)*c, буквы a и b неразличимы
+    vector<State> st = {State("0", true, false),
+                        State("1", false, true)};
+    vector<set<Transition>> tr {{Transition("a", 0), Transition("b", 0), Transition("c", 1)},
+                                {}};
+    Automaton plain(st, tr);
+    Automaton merged(st, tr);
+    merged.use_letter_classes();
+    plain.determinize();
+    merged.determinize();
+    EXPECT_EQ(merged.get_letter_classes(), vector<size_t>({0, 0, 2}));
+    EXPECT_EQ(plain.get_letter_classes(), vector<size_t>({0, 1, 2}));
+    EXPECT_EQ(merged.get_letter_id("c"), 2);
+    EXPECT_EQ(merged.get_letter_id("d"), Automaton::NO_LETTER);
+    EXPECT_EQ(merged.get_letter_id(""), Automaton::NO_LETTER);
+
+    plain.minimize(false);
+    merged.minimize(false);
+    std::stringstream plain_output, merged_output;
+    plain_output << plain;
+    merged_output << merged;
+    EXPECT_EQ(plain_output.str(), merged_output.str());
+    EXPECT_EQ(CompiledAutomaton(merged).get_class_number(), 3); // {a, b}, {c} и остальные байты
+}
+
+TEST(Matching, AutomatonAccepts){ // 2 задача 4 домашнего задания
+    vector<State> st = {State("0", true, true),
+                        State("1", false, false),
+                        State("2", false, false),
+                        State("3", false, false)};
     vector<set<Transition>> tr {{Transition("a", 1)},
                                 {Transition("b", 2), Transition("", 0), Transition("ab", 3)},
                                 {Transition("a", 3),Transition("ba", 2)},
                                 {Transition("", 1)}};
+    Automaton nfa(st, tr);
+    Automaton dfa(st, tr);
+    dfa.determinize();
+    dfa.minimize(false);
+    CompiledAutomaton compiled(dfa);
+
+    vector<string> words = {"", "a", "aa", "ab", "aab", "aba", "abba", "abaa", "abab", "abbaa", "aabaab", "b", "ba"};
+    for (const auto& word: words) {
+        EXPECT_EQ(nfa.accepts(word), dfa.accepts(word)) << word;
+        EXPECT_EQ(nfa.accepts(word), compiled.accepts(word)) << word;
+    }
+    EXPECT_TRUE(nfa.accepts("aab"));
+    EXPECT_FALSE(nfa.accepts("b"));
+}
+
+TEST(Matching, BatchAccepts){ // (a*b*c)*
+    vector<State> st = {State("0", true, true),
+                        State("1", false, false),
+                        State("2", false, false)};
+    vector<set<Transition>> tr {{Transition("a", 0), Transition("", 1)},
+                                {Transition("b", 1), Transition("", 2)},
+                                {Transition("c", 2), Transition("", 0)}};
+    Automaton test(st, tr);
+    test.determinize();
+    test.minimize(false);
+    const CompiledAutomaton compiled(test);
+
+    vector<string> storage;
+    for (size_t i = 0; i < 1000; ++i) {
+        storage.push_back(i % 3 == 0 ? "abcx" : string(i % 7, 'a') + "bc");
+    }
+    vector<std::string_view> words(storage.begin(), storage.end());
+    ThreadPool pool(4);
+    auto result = compiled.accepts_batch(words, pool);
+    ASSERT_EQ(result.size(), 16);
+    for (size_t i = 0; i < words.size(); ++i) {
+        EXPECT_EQ((result[i / 64] >> (i % 64)) & 1ull, i % 3 != 0) << i;
+    }
+}
 
+TEST(Matching, InterleavedAccepts){ // слова, в которых число букв a делится на 3, без букв c
+    vector<State> st = {State("0", true, true),
+                        State("1", false, false),
+                        State("2", false, false)};
+    vector<set<Transition>> tr {{Transition("a", 1), Transition("b", 0)},
+                                {Transition("a", 2), Transition("b", 1)},
+                                {Transition("a", 0), Transition("b", 2)}};
     Automaton test(st, tr);
-    EXPECT_THROW(test.determinize(), too_many_states_exception);
-    EXPECT_THROW(test.minimize(false), too_many_states_exception);
+    const CompiledAutomaton compiled(test);
+
+    vector<string> storage;
+    for (size_t i = 0; i < 517; ++i) {
+        string word;
+        for (size_t j = 0; j < (i * 37) % 23; ++j) {
+            word += "abc"[(i + j * j) % (i % 5 == 0 ? 3 : 2)];
+        }
+        storage.push_back(word);
+    }
+    vector<std::string_view> words(storage.begin(), storage.end());
+    auto result = compiled.accepts_interleaved(words);
+    for (size_t i = 0; i < words.size(); ++i) {
+        EXPECT_EQ(((result[i / 64] >> (i % 64)) & 1ull) == 1, compiled.accepts(words[i])) << words[i];
+    }
+}
+
+TEST(Matching, MappedFileLines){ // a(b|c)*
+    vector<State> st = {State("0", true, false),
+                        State("1", false, true)};
+    vector<set<Transition>> tr {{Transition("a", 1)},
+                                {Transition("b", 1), Transition("c", 1)}};
+    const CompiledAutomaton compiled{Automaton(st, tr)};
+
+    string path = testing::TempDir() + "automata_lines.txt";
+    string text;
+    vector<size_t> expected;
+    for (size_t i = 0; i < 5000; ++i) {
+        string line = (i % 4 == 0) ? "abcbc" : (i % 4 == 1) ? "xabc" : (i % 4 == 2) ? "" : "a";
+        if (i % 4 == 0 || i % 4 == 3) {
+            expected.push_back(text.size());
+        }
+        text += line + "\n";
+    }
+    text += "acb";  // последняя строка без перевода строки
+    expected.push_back(text.size() - 3);
+    std::ofstream(path, std::ios::binary) << text;
+
+    MappedFile file(path);
+    EXPECT_EQ(file.view(), text);
+    ThreadPool pool(3);
+    EXPECT_EQ(compiled.count_matching_lines(file.view(), pool), expected.size());
+    EXPECT_EQ(compiled.matching_line_offsets(file.view(), pool), expected);
+    EXPECT_EQ(compiled.count_matching_lines("", pool), 0);
+    EXPECT_THROW(MappedFile(path + ".missing"), file_mapping_exception);
+    std::remove(path.c_str());
+}
+
+TEST(Compiled, SaveAndLoad){ // 2 задача 4 домашнего задания
+    vector<State> st = {State("0", true, true),
+                        State("1", false, false),
+                        State("2", false, false),
+                        State("3", false, false)};
+    vector<set<Transition>> tr {{Transition("a", 1)},
+                                {Transition("b", 2), Transition("", 0), Transition("ab", 3)},
+                                {Transition("a", 3),Transition("ba", 2)},
+                                {Transition("", 1)}};
+    Automaton test(st, tr);
+    test.determinize();
+    test.minimize(false);
+    const CompiledAutomaton compiled(test);
+
+    string path = testing::TempDir() + "automata_compiled.bin";
+    compiled.save(path);
+    auto loaded = CompiledAutomaton::load(path);
+    EXPECT_EQ(loaded.get_state_number(), compiled.get_state_number());
+    EXPECT_EQ(loaded.get_class_number(), compiled.get_class_number());
+    EXPECT_EQ(loaded.get_start_state(), compiled.get_start_state());
+    auto copy = loaded;
+    for (const string word: {"", "a", "aab", "abba", "abaa", "abab", "aabaab", "b", "ba", "x"}) {
+        EXPECT_EQ(copy.accepts(word), compiled.accepts(word)) << word;
+    }
+
+    // испорченный файл либо отвергается, либо даёт автомат, шаги которого не выходят за его таблицы.
+    // Каждое слово из 4 байт заменяется на INT32_MAX, каждое слово из 8 байт - в том числе смещения
+    // секций в заголовке - на 2^64 - 8
+    std::stringstream saved;
+    saved << std::ifstream(path, std::ios::binary).rdbuf();
+    const string bytes = saved.str();
+    const string damaged_path = path + ".damaged";
+    size_t attempts = 0;
+    size_t rejected = 0;
+    auto try_load = [&](const size_t& offset, const void* garbage, const size_t& size) {
+        string corrupted = bytes;
+        std::memcpy(&corrupted[offset], garbage, size);
+        std::ofstream(damaged_path, std::ios::binary | std::ios::trunc) << corrupted;
+        ++attempts;
+        try {
+            auto damaged = CompiledAutomaton::load(damaged_path);
+            for (const string word: {"aab", "abba", "aabaab"}) {
+                static_cast<void>(damaged.accepts(word));
+                static_cast<void>(damaged.find_pattern_ids(word));
+            }
+        } catch (const bad_automaton_file_exception&) {
+            ++rejected;
+        }
+    };
+    const int32_t garbage = INT32_MAX;
+    const uint64_t wrapping = UINT64_MAX - 7;
+    for (size_t offset = 0; offset + sizeof(garbage) <= bytes.size(); offset += sizeof(garbage)) {
+        try_load(offset, &garbage, sizeof(garbage));
+    }
+    for (size_t offset = 0; offset + sizeof(wrapping) <= bytes.size(); offset += sizeof(wrapping)) {
+        try_load(offset, &wrapping, sizeof(wrapping));
+    }
+    EXPECT_GT(rejected, attempts / 2);
+
+    // смещение около 2^64 в сумме с длиной секции переполняется; table_offset и accept_offset лежат
+    // в заголовке с 56-го и 80-го байта, смещения наборов номеров шаблонов - со 104-го, 112-го и 120-го
+    for (const size_t field: {56, 80, 104, 112, 120}) {
+        string corrupted = bytes;
+        std::memcpy(&corrupted[field], &wrapping, sizeof(wrapping));
+        std::ofstream(damaged_path, std::ios::binary | std::ios::trunc) << corrupted;
+        EXPECT_THROW(CompiledAutomaton::load(damaged_path), bad_automaton_file_exception) << field;
+    }
+    std::remove(damaged_path.c_str());
+
+    std::ofstream(path, std::ios::binary) << "not an automaton at all, just some text to be long enough";
+    EXPECT_THROW(CompiledAutomaton::load(path), bad_automaton_file_exception);
+    std::remove(path.c_str());
+}
+
+TEST(Matching, LazyAutomatonCache){ // (a|b)*a(a|b)^8, у ДКА 512 состояний
+    const size_t n = 8;
+    vector<State> st;
+    vector<set<Transition>> tr(n + 2);
+    for (size_t i = 0; i < n + 2; ++i) {
+        st.emplace_back(std::to_string(i), i == 0, i == n + 1);
+    }
+    tr[0] = {Transition("a", 0), Transition("b", 0), Transition("a", 1)};
+    for (size_t i = 1; i <= n; ++i) {
+        tr[i] = {Transition("a", i + 1), Transition("b", i + 1)};
+    }
+    Automaton nfa(st, tr);
+    LazyAutomaton lazy(nfa, 16);
+
+    for (size_t mask = 0; mask < 2048; mask += 7) {
+        string word;
+        for (size_t j = 0; j < 11; ++j) {
+            word += (mask >> j) & 1 ? 'a' : 'b';
+        }
+        EXPECT_EQ(lazy.accepts(word), nfa.accepts(word)) << word;
+        EXPECT_LE(lazy.get_cached_state_number(), 16);
+    }
+    EXPECT_GT(lazy.get_flush_number(), 0);
+    EXPECT_FALSE(lazy.accepts("abc"));
+}
+
+TEST(Automata, ParallelDeterminize){ // (a|b)*a(a|b)^8 и домашнее задание
+    const size_t n = 8;
+    vector<State> st;
+    vector<set<Transition>> tr(n + 2);
+    for (size_t i = 0; i < n + 2; ++i) {
+        st.emplace_back(std::to_string(i), i == 0, i == n + 1);
+    }
+    tr[0] = {Transition("a", 0), Transition("b", 0), Transition("a", 1)};
+    for (size_t i = 1; i <= n; ++i) {
+        tr[i] = {Transition("a", i + 1), Transition("b", i + 1)};
+    }
+    vector<State> homework_st = {State("0", true, true),
+                                 State("1", false, false),
+                                 State("2", false, false),
+                                 State("3", false, false)};
+    vector<set<Transition>> homework_tr {{Transition("a", 1)},
+                                         {Transition("b", 2), Transition("", 0), Transition("ab", 3)},
+                                         {Transition("a", 3),Transition("ba", 2)},
+                                         {Transition("", 1)}};
+
+    ThreadPool pool(4);
+    for (const auto& [states, transitions]: {pair(st, tr), pair(homework_st, homework_tr)}) {
+        Automaton sequential(states, transitions);
+        Automaton parallel(states, transitions);
+        sequential.determinize();
+        parallel.determinize(pool);
+        std::stringstream sequential_output, parallel_output;
+        sequential_output << sequential;
+        parallel_output << parallel;
+        EXPECT_EQ(sequential_output.str(), parallel_output.str());
+    }
+}
+
+TEST(Automata, EpsilonClosureCycles){ // eps-цикл 0 -> 1 -> 2 -> 0 и eps-хвост 2 -> 3 -> 4
+    vector<State> st = {State("0", true, false),
+                        State("1", false, false),
+                        State("2", false, false),
+                        State("3", false, false),
+                        State("4", false, true)};
+    vector<set<Transition>> tr {{Transition("", 1), Transition("a", 0)},
+                                {Transition("", 2), Transition("b", 3)},
+                                {Transition("", 0), Transition("", 3)},
+                                {Transition("", 4)},
+                                {Transition("c", 4)}};
+    Automaton test(st, tr);
+    test.make_one_letter();
+    // 0, 1, 2 видят a->0, b->3, c->4; 3 видит c->4; у 4 - c->4
+    EXPECT_EQ(test.get_transition_number(), 11);
+    for (size_t i = 0; i < 5; ++i) {
+        EXPECT_TRUE(test.get_states()[i].get_is_accept());
+    }
+    EXPECT_TRUE(test.accepts("ab"));
+    EXPECT_TRUE(test.accepts("acc"));
+    EXPECT_FALSE(test.accepts("ca"));
+}
+
+TEST(Automata, SharedPrefixesInMakeOneLetter){ // из 1 по aba и abab: общий префикс aba
+    vector<State> st = {State("0", true, false),
+                        State("1", false, false),
+                        State("2", false, true)};
+    vector<set<Transition>> tr = {{Transition("abab", 1)},
+                                  {Transition("aba", 2), Transition("abab", 1), Transition("abc", 2)},
+                                  {Transition("abaabaaba", 2)}};
+    Automaton test(st, tr);
+    Automaton original(st, tr);
+    test.make_one_letter();
+    // 3 + 3 (abab из 0) + 3 (бор из 1: a, ab, aba) + 8 (abaabaaba)
+    EXPECT_EQ(test.get_state_number(), 17);
+    EXPECT_EQ(test.get_transition_number(), 4 + 6 + 9);
+    for (const string word: {"abababa", "ababababab", "abababc", "abababaabaaba", "ababab", "ababa"}) {
+        EXPECT_EQ(test.accepts(word), original.accepts(word)) << word;
+    }
+}
+
+TEST(Automata, PartialMinimize){ // 2 задача 4 домашнего задания, без стока
+    vector<State> st = {State("0", true, true),
+                        State("1", false, false),
+                        State("2", false, false),
+                        State("3", false, false)};
+    vector<set<Transition>> tr {{Transition("a", 1)},
+                                {Transition("b", 2), Transition("", 0), Transition("ab", 3)},
+                                {Transition("a", 3),Transition("ba", 2)},
+                                {Transition("", 1)}};
+    Automaton partial(st, tr);
+    Automaton complete(st, tr);
+    Automaton original(st, tr);
+    partial.minimize_partial();
+    complete.determinize();
+    complete.minimize(false);
+    // полный минимальный ДКА - это частичный плюс сток
+    EXPECT_EQ(partial.get_state_number() + 1, complete.get_state_number());
+    EXPECT_EQ(partial.get_transition_number(), 8);  // 12 переходов минус 2 петли стока и 2 перехода в сток
+    for (const string word: {"", "a", "aab", "abba", "abaa", "abab", "aabaab", "b", "ba", "abbaaba"}) {
+        EXPECT_EQ(partial.accepts(word), original.accepts(word)) << word;
+    }
+}
+
+TEST(Automata, PartialMinimizeDropsDeadStates){ // 2 и 3 не ведут в принимающее, 4 недостижимо
+    vector<State> st = {State("0", true, false),
+                        State("1", false, true),
+                        State("2", false, false),
+                        State("3", false, false),
+                        State("4", false, true)};
+    vector<set<Transition>> tr {{Transition("a", 1), Transition("b", 2)},
+                                {Transition("a", 1), Transition("c", 3)},
+                                {Transition("a", 3)},
+                                {Transition("a", 2)},
+                                {Transition("a", 1)}};
+    Automaton test(st, tr);
+    test.minimize_partial();
+    EXPECT_EQ(test.get_state_number(), 2);
+    EXPECT_EQ(test.get_transition_number(), 2);
+    EXPECT_EQ(test.get_states()[0].get_name(), "0");
+    EXPECT_TRUE(test.accepts("aaa"));
+    EXPECT_FALSE(test.accepts("ba"));
+
+    vector<set<Transition>> empty_tr {{Transition("b", 2)}, {}, {Transition("a", 3)}, {Transition("a", 2)}, {}};
+    Automaton empty(st, empty_tr);
+    empty.minimize_partial();
+    EXPECT_EQ(empty.get_state_number(), 1);
+    EXPECT_EQ(empty.get_transition_number(), 0);
+}
+
+TEST(Automata, DictionaryBuilder){
+    vector<string> words = {"", "cat", "cats", "dog", "dogs", "fat", "fats", "rat", "rats"};
+    DictionaryBuilder builder;
+    for (const auto& word: words) {
+        builder.add(word);
+    }
+    builder.add("rats");  // повтор пропускается
+    Automaton dictionary = builder.finish();
+    // корень, {c, f, r}, {c, f, r}a, d, do, общие t/g (принимающее) и s (принимающее)
+    EXPECT_EQ(dictionary.get_state_number(), 7);
+    for (const auto& word: words) {
+        EXPECT_TRUE(dictionary.accepts(word)) << word;
+    }
+    EXPECT_FALSE(dictionary.accepts("ca"));
+    EXPECT_FALSE(dictionary.accepts("dots"));
+
+    Automaton minimal = dictionary;
+    minimal.minimize_partial();
+    EXPECT_EQ(minimal.get_state_number(), dictionary.get_state_number());
+    EXPECT_TRUE(CompiledAutomaton(dictionary).accepts("fats"));
+
+    builder.add("b");
+    EXPECT_THROW(builder.add("a"), unsorted_words_exception);
+}
+
+TEST(Product, Operations){ // (a|b)*a и слова чётной длины над {a, b, c}
+    vector<State> ends_with_a_st = {State("0", true, false),
+                                    State("1", false, true)};
+    vector<set<Transition>> ends_with_a_tr {{Transition("a", 0), Transition("b", 0), Transition("a", 1)},
+                                            {}};
+    vector<State> even_st = {State("0", true, true),
+                             State("1", false, false)};
+    vector<set<Transition>> even_tr {{Transition("a", 1), Transition("b", 1), Transition("c", 1)},
+                                     {Transition("a", 0), Transition("b", 0), Transition("c", 0)}};
+    Automaton ends_with_a(ends_with_a_st, ends_with_a_tr);
+    Automaton even(even_st, even_tr);
+
+    ProductAutomaton both(ends_with_a, even, ProductOperation::intersection);
+    ProductAutomaton any(ends_with_a, even, ProductOperation::united);
+    ProductAutomaton only_first(ends_with_a, even, ProductOperation::difference);
+    for (const string word: {"", "a", "ba", "aba", "abba", "cc", "ca", "cca", "bbbb"}) {
+        bool in_first = ends_with_a.accepts(word);
+        bool in_second = even.accepts(word);
+        EXPECT_EQ(both.accepts(word), in_first && in_second) << word;
+        EXPECT_EQ(any.accepts(word), in_first || in_second) << word;
+        EXPECT_EQ(only_first.accepts(word), in_first && !in_second) << word;
+    }
+    EXPECT_EQ(both.find_word(), string("aa"));
+    EXPECT_EQ(only_first.find_word(), string("a"));
+    EXPECT_FALSE(both.is_empty());
+
+    Automaton united = any.materialize();
+    EXPECT_TRUE(united.accepts("cc"));
+    EXPECT_TRUE(united.accepts("bba"));
+    EXPECT_FALSE(united.accepts("c"));
+
+    ProductAutomaton nothing(ends_with_a, ends_with_a, ProductOperation::difference);
+    EXPECT_TRUE(nothing.is_empty());
+}
+
+TEST(Product, NondeterministicOperands){ // (a|b)*a(a|b)^15 - у ДКА 2^16 состояний - и слово b^15 a b^15
+    const size_t n = 15;
+    vector<State> st;
+    vector<set<Transition>> tr(n + 2);
+    for (size_t i = 0; i < n + 2; ++i) {
+        st.emplace_back(std::to_string(i), i == 0, i == n + 1);
+    }
+    tr[0] = {Transition("a", 0), Transition("b", 0), Transition("a", 1)};
+    for (size_t i = 1; i <= n; ++i) {
+        tr[i] = {Transition("a", i + 1), Transition("b", i + 1)};
+    }
+    Automaton nth_from_end(st, tr);
+    const string word = string(n, 'b') + "a" + string(n, 'b');
+    vector<State> word_st = {State("0", true, false), State("1", false, true)};
+    vector<set<Transition>> word_tr {{Transition(word, 1)}, {}};
+    Automaton only_word(word_st, word_tr);
+
+    ProductAutomaton both(nth_from_end, only_word, ProductOperation::intersection);
+    EXPECT_EQ(both.find_word(), word);
+    Automaton materialized = both.materialize();
+    EXPECT_TRUE(materialized.accepts(word));
+    EXPECT_FALSE(materialized.accepts(word + "b"));
+    EXPECT_LE(both.get_built_state_number(), word.size() + 1);
+
+    // после a(a|b)^15 (a|b)*a(a|b)^15 уже не примет ничего: пара с мёртвой второй компонентой не создаётся
+    EXPECT_FALSE(both.accepts(word + "b"));
+    ProductAutomaton rest(nth_from_end, only_word, ProductOperation::difference);
+    EXPECT_FALSE(rest.is_empty());
+}
+
+TEST(Product, EmptyStart){ // начальная пара мёртвая - пустой язык из одного состояния
+    vector<State> st = {State("0", true, false), State("1", false, false)};
+    vector<set<Transition>> tr {{Transition("a", 1)}, {Transition("a", 0)}};
+    Automaton never(st, tr);
+    vector<State> all_st = {State("q", true, true)};
+    vector<set<Transition>> all_tr {{Transition("a", 0)}};
+    Automaton all(all_st, all_tr);
+
+    ProductAutomaton both(never, all, ProductOperation::intersection);
+    EXPECT_EQ(both.get_built_state_number(), 0);
+    EXPECT_TRUE(both.is_empty());
+    Automaton materialized = both.materialize();
+    EXPECT_EQ(materialized.get_state_number(), 1);
+    EXPECT_EQ(materialized.get_start_state(), 0);
+    EXPECT_FALSE(materialized.accepts(""));
+    EXPECT_FALSE(materialized.accepts("a"));
+}
+
+TEST(LanguageChecks, Equivalent){ // (a*b*c)* как НКА и как {a, b, c}*
+    vector<State> st = {State("0", true, true),
+                        State("1", false, false),
+                        State("2", false, false)};
+    vector<set<Transition>> tr {{Transition("a", 0), Transition("", 1)},
+                                {Transition("b", 1), Transition("", 2)},
+                                {Transition("c", 2), Transition("", 0)}};
+    vector<State> all_st = {State("q", true, true)};
+    vector<set<Transition>> all_tr {{Transition("a", 0), Transition("b", 0), Transition("c", 0)}};
+    vector<set<Transition>> no_c_tr {{Transition("a", 0), Transition("b", 0), Transition("cab", 0)}};
+    Automaton nfa(st, tr);
+    Automaton all(all_st, all_tr);
+    Automaton no_single_c(all_st, no_c_tr);
+
+    auto result = equivalent(nfa, all);
+    EXPECT_TRUE(result.holds);
+
+    result = equivalent(nfa, no_single_c);
+    EXPECT_FALSE(result.holds);
+    EXPECT_EQ(result.witness, "c");
+    EXPECT_NE(nfa.accepts(result.witness), no_single_c.accepts(result.witness));
+}
+
+TEST(LanguageChecks, InclusionAndUniversality){ // (a|b)*a(a|b)^6 ⊆ (a|b)*a(a|b)^6 + (a|b)*b(a|b)^6 = (a|b)^{7,}
+    const size_t n = 6;
+    auto nth_from_end = [&](const string& letter) {
+        vector<State> st;
+        vector<set<Transition>> tr(n + 2);
+        for (size_t i = 0; i < n + 2; ++i) {
+            st.emplace_back(std::to_string(i), i == 0, i == n + 1);
+        }
+        tr[0] = {Transition("a", 0), Transition("b", 0), Transition(letter, 1)};
+        for (size_t i = 1; i <= n; ++i) {
+            tr[i] = {Transition("a", i + 1), Transition("b", i + 1)};
+        }
+        return Automaton(st, tr);
+    };
+    Automaton with_a = nth_from_end("a");
+    Automaton with_b = nth_from_end("b");
+    ProductAutomaton any(with_a, with_b, ProductOperation::united);
+    Automaton either = any.materialize();
+
+    EXPECT_TRUE(is_included(with_a, either).holds);
+    auto result = is_included(with_a, with_b);
+    EXPECT_FALSE(result.holds);
+    EXPECT_TRUE(with_a.accepts(result.witness));
+    EXPECT_FALSE(with_b.accepts(result.witness));
+
+    result = is_universal(either);
+    EXPECT_FALSE(result.holds);
+    EXPECT_EQ(result.witness, "");
+
+    vector<State> st = {State("0", true, true),
+                        State("1", false, true)};
+    vector<set<Transition>> tr {{Transition("a", 1), Transition("", 1)},
+                                {Transition("b", 0), Transition("a", 1)}};
+    EXPECT_TRUE(is_universal(Automaton(st, tr)).holds);
+}
+
+TEST(Additional, Stats){ // (a|b)*ab(a|b)^6
+    const size_t n = 6;
+    vector<State> st;
+    vector<set<Transition>> tr(n + 2);
+    for (size_t i = 0; i < n + 2; ++i) {
+        st.emplace_back(std::to_string(i), i == 0, i == n + 1);
+    }
+    tr[0] = {Transition("a", 0), Transition("b", 0), Transition("ab", 1)};
+    for (size_t i = 1; i <= n; ++i) {
+        tr[i] = {Transition("a", i + 1), Transition("b", i + 1)};
+    }
+    Automaton automaton(st, tr);
+    Automaton without_stats = automaton;
+    AutomatonStats stats;
+    automaton.set_stats(&stats);
+    automaton.determinize();
+    automaton.minimize();
+    without_stats.determinize();
+    without_stats.minimize();
+
+    EXPECT_EQ(automaton.get_states().size(), without_stats.get_states().size());
+    EXPECT_EQ(stats.subset_states_created, 55); // вхождения ab не соседствуют - подмножеств столько же, сколько чисел Фибоначчи
+    EXPECT_EQ(stats.map_lookups, stats.subset_states_created + stats.duplicate_subsets);
+    EXPECT_GT(stats.duplicate_subsets, 0);
+    EXPECT_GT(stats.refinement_rounds, 0);
+    EXPECT_GT(stats.peak_memory_kb, 0);
+    EXPECT_GE(stats.subset_construction_seconds, 0);
+
+    std::stringstream output;
+    output << stats;
+    EXPECT_NE(output.str().find("subset states: 55 created"), string::npos);
+
+    // копии, в том числе внутренние копии библиотеки, статистику не пишут
+    Automaton nfa(st, tr);
+    AutomatonStats untouched;
+    nfa.set_stats(&untouched);
+    Automaton copy = nfa;
+    copy.determinize();
+    const CompiledAutomaton compiled = CompiledAutomaton::determinized(nfa);
+    EXPECT_TRUE(is_included(nfa, nfa).holds);
+    EXPECT_EQ(untouched.subset_states_created, 0);
+    EXPECT_EQ(untouched.map_lookups, 0);
+    EXPECT_EQ(untouched.letter_splitting_seconds, 0);
+}
+
+TEST(Additional, LazyStateNames){
+    vector<State> st = {State("p", true, false),
+                        State("q", false, false),
+                        State("r", false, true)};
+    vector<set<Transition>> tr {{Transition("a", 0), Transition("a", 1), Transition("b", 2)},
+                                {Transition("a", 2)},
+                                {Transition("a", 2), Transition("b", 2)}};
+    Automaton automaton(st, tr);
+    automaton.determinize();
+    Automaton copy = automaton;
+    vector<string> names;
+    for (const auto& state: automaton.get_states()) {
+        names.push_back(state.get_name());
+    }
+    EXPECT_THAT(names, testing::ElementsAre("p", "pq", "r", "pqr"));
+
+    copy.minimize();
+    names.clear();
+    for (const auto& state: copy.get_states()) {
+        names.push_back(state.get_name());
+    }
+    EXPECT_THAT(names, testing::ElementsAre("p", "pq", "r+pqr"));
+
+    // get_name() ничего не меняет: копии с общей историей можно печатать из разных потоков
+    Automaton other_copy = copy;
+    vector<string> first_names, second_names;
+    std::thread first([&]() {
+        for (const auto& state: copy.get_states()) {
+            first_names.push_back(state.get_name());
+        }
+    });
+    for (const auto& state: other_copy.get_states()) {
+        second_names.push_back(state.get_name());
+    }
+    first.join();
+    EXPECT_EQ(first_names, names);
+    EXPECT_EQ(second_names, names);
+}
+
+TEST(Matching, BitParallel){ // (a|b)*ab(a|b)^n: одно слово маски, несколько слов с таблицами и без них
+    for (size_t n: {20, 100, 3000}) {
+        vector<State> st;
+        vector<set<Transition>> tr(n + 2);
+        for (size_t i = 0; i < n + 2; ++i) {
+            st.emplace_back(std::to_string(i), i == 0, i == n + 1);
+        }
+        tr[0] = {Transition("a", 0), Transition("b", 0), Transition("ab", 1)};
+        for (size_t i = 1; i <= n; ++i) {
+            tr[i] = {Transition("a", i + 1), Transition("b", i + 1)};
+        }
+        tr[1].emplace("", 3);
+        Automaton automaton(st, tr);
+        BitParallelMatcher matcher(automaton);
+        EXPECT_EQ(matcher.get_state_number(), n + 3); // ab делится на две буквы через новое состояние
+        EXPECT_EQ(matcher.get_word_number(), (n + 3 + 63) / 64);
+
+        std::mt19937 rng(n);
+        for (size_t i = 0; i < (n < 1000 ? 500 : 20); ++i) {
+            string word(rng() % (2 * n), 'a');
+            for (auto& c: word) {
+                c = rng() % 200 == 0 ? 'c' : "ab"[rng() % 2];
+            }
+            EXPECT_EQ(matcher.accepts(word), automaton.accepts(word)) << word;
+        }
+    }
+}
+
+TEST(Matching, BitParallelLargeAlphabet){ // [a-z]*x[a-z]^n: без таблиц байтов, номера состояний в обратном порядке
+    string alphabet;
+    for (char c = 'a'; c <= 'z'; ++c) {
+        alphabet += c;
+    }
+    for (size_t n: {38, 150}) {
+        vector<State> st;
+        vector<set<Transition>> tr(n + 2);
+        auto id = [&](const size_t& i) { return n + 1 - i; };  // состояние i цепочки
+        for (size_t i = 0; i < n + 2; ++i) {
+            st.emplace_back(std::to_string(i), i == n + 1, i == 0);
+        }
+        for (const char& c: alphabet) {
+            tr[id(0)].emplace(string(1, c), id(0));
+            for (size_t i = 1; i <= n; ++i) {
+                tr[id(i)].emplace(string(1, c), id(i + 1));
+            }
+        }
+        tr[id(0)].emplace("x", id(1));
+        Automaton automaton(st, tr);
+        BitParallelMatcher matcher(automaton);
+        EXPECT_EQ(matcher.get_word_number(), (n + 2 + 63) / 64);
+
+        std::mt19937 rng(n);
+        for (size_t i = 0; i < 100; ++i) {
+            string word(rng() % (2 * n), 'a');
+            for (auto& c: word) {
+                c = rng() % 10 == 0 ? 'x' : alphabet[rng() % alphabet.size()];
+            }
+            EXPECT_EQ(matcher.accepts(word), automaton.accepts(word)) << word;
+        }
+    }
+}
+
+TEST(Matching, MultiPattern){ // he, she, his, hers и h(e|i)s
+    auto word_pattern = [](const string& word) {
+        vector<State> st = {State("0", true, false), State("1", false, true)};
+        vector<set<Transition>> tr {{Transition(word, 1)}, {}};
+        return Automaton(st, tr);
+    };
+    vector<State> st = {State("0", true, false), State("1", false, false),
+                        State("2", false, false), State("3", false, true)};
+    vector<set<Transition>> tr {{Transition("h", 1)}, {Transition("e", 2), Transition("i", 2)},
+                                {Transition("s", 3)}, {}};
+    vector<Automaton> patterns = {word_pattern("he"), word_pattern("she"), word_pattern("his"),
+                                  word_pattern("hers"), Automaton(st, tr)};
+
+    Automaton anchored = pattern_union(patterns);
+    anchored.determinize();
+    anchored.minimize();
+    const CompiledAutomaton whole_words(anchored);
+    EXPECT_THAT(whole_words.matching_ids("his"), testing::ElementsAre(2, 4));
+    EXPECT_THAT(whole_words.matching_ids("hes"), testing::ElementsAre(4));
+    EXPECT_THAT(whole_words.matching_ids("he"), testing::ElementsAre(0));
+    EXPECT_THAT(whole_words.matching_ids("hers"), testing::ElementsAre(3));
+    EXPECT_TRUE(whole_words.matching_ids("her").empty());
+
+    // у a и b одинаковые переходы, но разные шаблоны - минимизация не должна их склеить
+    Automaton two = pattern_union({word_pattern("a"), word_pattern("b")});
+    two.determinize();
+    Automaton two_partial = two;
+    Automaton two_moore = two;
+    two.minimize();
+    two_partial.minimize_partial();
+    std::stringstream log;
+    two_moore.minimize(true, log);
+    for (const auto& minimized: {two, two_partial, two_moore}) {
+        const CompiledAutomaton compiled(minimized);
+        EXPECT_THAT(compiled.matching_ids("a"), testing::ElementsAre(0));
+        EXPECT_THAT(compiled.matching_ids("b"), testing::ElementsAre(1));
+    }
+
+    Automaton unanchored = pattern_union(patterns, true);
+    unanchored.determinize();
+    unanchored.minimize();
+    const CompiledAutomaton search(unanchored);
+    const vector<pair<size_t, uint32_t>> expected = {{4, 0}, {4, 1}, {6, 3}, {10, 2}, {10, 4}, {13, 0}, {14, 4}};
+    EXPECT_EQ(search.find_pattern_ids("ushers his hes"), expected);
+
+    string path = testing::TempDir() + "automata_patterns.bin";
+    search.save(path);
+    EXPECT_EQ(CompiledAutomaton::load(path).find_pattern_ids("ushers his hes"), expected);
+    std::remove(path.c_str());
+}
+
+TEST(Compiled, RowDisplacement){ // словарь: у большинства состояний один-два перехода из 26 букв
+    std::mt19937 rng(7);
+    set<string> dictionary;
+    while (dictionary.size() < 2000) {
+        string word(3 + rng() % 8, 'a');
+        for (auto& c: word) {
+            c = char('a' + rng() % 26);
+        }
+        dictionary.insert(word);
+    }
+    DictionaryBuilder builder;
+    for (const auto& word: dictionary) {
+        builder.add(word);
+    }
+    Automaton automaton = builder.finish();
+    const CompiledAutomaton dense(automaton);
+    const CompiledAutomaton packed(automaton, TableLayout::row_displacement);
+    EXPECT_EQ(packed.get_layout(), TableLayout::row_displacement);
+    EXPECT_LT(packed.get_table_bytes() * 4, dense.get_table_bytes());
+
+    vector<string> storage(dictionary.begin(), dictionary.end());
+    for (size_t i = 0; i < 2000; ++i) {
+        string word = storage[i];
+        word[rng() % word.size()] = char('a' + rng() % 27);
+        storage.push_back(word);
+    }
+    vector<std::string_view> words(storage.begin(), storage.end());
+    for (const auto& word: words) {
+        EXPECT_EQ(packed.accepts(word), dense.accepts(word)) << word;
+    }
+    EXPECT_EQ(packed.accepts_interleaved(words), dense.accepts_interleaved(words));
+
+    string path = testing::TempDir() + "automata_packed.bin";
+    packed.save(path);
+    auto loaded = CompiledAutomaton::load(path);
+    EXPECT_EQ(loaded.get_layout(), TableLayout::row_displacement);
+    EXPECT_EQ(loaded.get_table_bytes(), packed.get_table_bytes());
+    EXPECT_EQ(loaded.accepts_interleaved(words), dense.accepts_interleaved(words));
+
+    // сдвиг строки за концом упакованных массивов и чужой номер в check отвергаются (портится
+    // каждое 97-е слово файла, чтобы тест оставался быстрым)
+    std::stringstream saved;
+    saved << std::ifstream(path, std::ios::binary).rdbuf();
+    const string bytes = saved.str();
+    const string damaged_path = path + ".damaged";
+    size_t rejected = 0;
+    for (size_t offset = 0; offset + sizeof(int32_t) <= bytes.size(); offset += 97 * sizeof(int32_t)) {
+        string corrupted = bytes;
+        const int32_t garbage = INT32_MAX;
+        std::memcpy(&corrupted[offset], &garbage, sizeof(garbage));
+        std::ofstream(damaged_path, std::ios::binary | std::ios::trunc) << corrupted;
+        try {
+            static_cast<void>(CompiledAutomaton::load(damaged_path).accepts_interleaved(words));
+        } catch (const bad_automaton_file_exception&) {
+            ++rejected;
+        }
+    }
+    EXPECT_GT(rejected, bytes.size() / sizeof(int32_t) / 97 / 2);
+    std::remove(damaged_path.c_str());
+    std::remove(path.c_str());
+}
+
+TEST(Matching, ParallelLongText){ // (a|b)*a(a|b)^3 по тексту в 1 МБ, разделённому между четырьмя потоками
+    const size_t n = 3;
+    vector<State> st;
+    vector<set<Transition>> tr(n + 2);
+    for (size_t i = 0; i < n + 2; ++i) {
+        st.emplace_back(std::to_string(i), i == 0, i == n + 1);
+    }
+    tr[0] = {Transition("a", 0), Transition("b", 0), Transition("a", 1)};
+    for (size_t i = 1; i <= n; ++i) {
+        tr[i] = {Transition("a", i + 1), Transition("b", i + 1)};
+    }
+    Automaton automaton(st, tr);
+    automaton.determinize();
+    automaton.minimize();
+    const CompiledAutomaton compiled(automaton);
+    ThreadPool pool(4);
+
+    std::mt19937 rng(11);
+    string text(1 << 20, 'a');
+    for (auto& c: text) {
+        c = "ab"[rng() % 2];
+    }
+    for (std::string_view ending: {"aaaa", "abbb", "bbbb", "babb"}) {
+        text.replace(text.size() - 4, 4, ending);
+        int32_t state = compiled.get_start_state();
+        for (const char& c: text) {
+            state = compiled.step(state, c);
+        }
+        EXPECT_EQ(compiled.run_parallel(text, pool), state);
+        EXPECT_EQ(compiled.accepts_parallel(text, pool), ending[0] == 'a');
+    }
+    text[text.size() / 2] = 'c';
+    EXPECT_EQ(compiled.run_parallel(text, pool), CompiledAutomaton::DEAD_STATE);
+}
+
+TEST(Matching, ParallelCounter){ // число a по модулю k: дорожки никогда не склеиваются
+    ThreadPool pool(4);
+    std::mt19937 rng(12);
+    string text(1 << 20, 'a');
+    for (auto& c: text) {
+        c = "ab"[rng() % 2];
+    }
+    const size_t a_number = std::count(text.begin(), text.end(), 'a');
+    // 3 дорожки ещё идут вместе, 7 - уже слишком много, у 5000 состояний слишком дорог первый блок
+    for (size_t k: {3, 7, 5000}) {
+        vector<State> st;
+        vector<set<Transition>> tr(k);
+        for (size_t i = 0; i < k; ++i) {
+            st.emplace_back(std::to_string(i), i == 0, i == 0);
+            tr[i] = {Transition("a", (i + 1) % k), Transition("b", i)};
+        }
+        const CompiledAutomaton compiled{Automaton(st, tr)};
+        EXPECT_EQ(compiled.run_parallel(text, pool), static_cast<int32_t>(a_number % k));
+        EXPECT_EQ(compiled.accepts_parallel(text, pool), a_number % k == 0);
+    }
+}
+
+
+TEST(Export, CppMatcher){ // ab и его мёртвое состояние
+    vector<State> st = {State("0", true, false), State("1", false, false),
+                        State("2", false, true), State("3", false, false)};
+    vector<set<Transition>> tr {{Transition("a", 1), Transition("b", 3)}, {Transition("b", 2), Transition("a", 3)},
+                                {}, {Transition("a", 3), Transition("b", 3)}};
+    Automaton automaton(st, tr);
+    std::stringstream output;
+    automaton.cpp_matcher_print(output, "matches");
+    EXPECT_EQ(output.str(), "// Generated from a DFA with 4 states\n"
+                            "inline bool matches(std::string_view word) {\n"
+                            "    const unsigned char* p = reinterpret_cast<const unsigned char*>(word.data());\n"
+                            "    const unsigned char* const end = p + word.size();\n"
+                            "    goto state_0;\n"
+                            "state_0:\n"
+                            "    if (p == end) {\n"
+                            "        return false;\n"
+                            "    }\n"
+                            "    switch (*p++) {\n"
+                            "        case 97:\n"
+                            "            goto state_1;\n"
+                            "        case 98:\n"
+                            "            goto state_3;\n"
+                            "        default:\n"
+                            "            return false;\n"
+                            "    }\n"
+                            "state_1:\n"
+                            "    if (p == end) {\n"
+                            "        return false;\n"
+                            "    }\n"
+                            "    switch (*p++) {\n"
+                            "        case 98:\n"
+                            "            goto state_2;\n"
+                            "        case 97:\n"
+                            "            goto state_3;\n"
+                            "        default:\n"
+                            "            return false;\n"
+                            "    }\n"
+                            "state_2:\n"
+                            "    if (p == end) {\n"
+                            "        return true;\n"
+                            "    }\n"
+                            "    switch (*p++) {\n"
+                            "        default:\n"
+                            "            return false;\n"
+                            "    }\n"
+                            "state_3:\n"
+                            "    return false;\n"
+                            "}\n");
+
+    std::stringstream table_output;
+    automaton.cpp_matcher_print(table_output, "matches", true);
+    const string tables = table_output.str();
+    EXPECT_NE(tables.find("static constexpr std::uint8_t next[][256]"), string::npos);
+    EXPECT_NE(tables.find("static constexpr bool accept[] = {false, false, true, false, false};"), string::npos);
+    EXPECT_NE(tables.find("std::uint8_t state = 0;"), string::npos);
+
+    vector<set<Transition>> nfa_tr {{Transition("ab", 2)}, {}, {}, {}};
+    std::stringstream nfa_output;
+    EXPECT_THROW(Automaton(st, nfa_tr).cpp_matcher_print(nfa_output, "matches"), not_deterministic_exception);
+}
+
+TEST(Export, GeneratedMatcher){ // test_matcher.h из codegen (см. CMakeLists.txt): he, she, his, hers
+    vector<Automaton> patterns;
+    string letters;
+    for (const string word: matches_patterns) {
+        vector<State> st = {State("0", true, false), State("1", false, true)};
+        vector<set<Transition>> tr {{Transition(word, 1)}, {}};
+        patterns.emplace_back(st, tr);
+        letters += word;
+    }
+    Automaton automaton = pattern_union(patterns, true);
+    automaton.determinize();
+    automaton.minimize();
+    const CompiledAutomaton compiled(automaton);
+
+    std::mt19937 rng(25);
+    for (size_t i = 0; i < 2000; ++i) {
+        string text(rng() % 12, 'h');  // x - байт не из алфавита
+        for (auto& c: text) {
+            c = rng() % 50 == 0 ? 'x' : letters[rng() % letters.size()];
+        }
+        EXPECT_EQ(matches(text), compiled.accepts(text)) << text;
+        EXPECT_EQ(matches_tables(text), compiled.accepts(text)) << text;
+    }
+    EXPECT_TRUE(matches("shers"));
+    EXPECT_TRUE(matches_tables("hishe"));
+    EXPECT_FALSE(matches("hex"));
 }
 
 
@@ -0,0 +1,87 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(size_t thread_number) {
+    if (thread_number == 0) {
+        thread_number = 1;
+    }
+    workers.reserve(thread_number);
+    for (size_t i = 0; i < thread_number; ++i) {
+        workers.emplace_back(&ThreadPool::_work, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    has_task.notify_all();
+    for (auto& worker: workers) {
+        worker.join();
+    }
+}
+
+size_t ThreadPool::get_thread_number() const {
+    return workers.size();
+}
+
+void ThreadPool::_work() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            has_task.wait(lock, [this] { return stopping || !tasks.empty(); });
+            if (tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task();
+    }
+}
+
+void ThreadPool::parallel_for(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body) {
+    if (count == 0) {
+        return;
+    }
+    if (grain == 0) {
+        grain = 1;
+    }
+    // по несколько отрезков на поток, чтобы неровная нагрузка выравнивалась
+    size_t chunk = (count + workers.size() * 4 - 1) / (workers.size() * 4);
+    chunk = (chunk + grain - 1) / grain * grain;
+    size_t chunk_number = (count + chunk - 1) / chunk;
+
+    std::mutex done_mutex;
+    std::condition_variable done;
+    size_t remaining = chunk_number;
+    std::exception_ptr error;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t begin = 0; begin < count; begin += chunk) {
+            size_t end = std::min(count, begin + chunk);
+            tasks.emplace([&, begin, end] {
+                try {
+                    body(begin, end);
+                } catch (...) {
+                    std::lock_guard<std::mutex> error_lock(done_mutex);
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                }
+                std::lock_guard<std::mutex> done_lock(done_mutex);
+                if (--remaining == 0) {
+                    done.notify_one();
+                }
+            });
+        }
+    }
+    has_task.notify_all();
+
+    std::unique_lock<std::mutex> lock(done_mutex);
+    done.wait(lock, [&] { return remaining == 0; });
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
@@ -0,0 +1,38 @@
+#ifndef AUTOMATA_THREAD_POOL_H
+#define AUTOMATA_THREAD_POOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+
+// Фиксированный набор потоков, который переиспользуется между вызовами parallel_for
+class ThreadPool{
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable has_task;
+    bool stopping = false;
+
+public:
+    explicit ThreadPool(size_t thread_number = std::thread::hardware_concurrency());
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    ~ThreadPool();
+
+    [[nodiscard]] size_t get_thread_number() const;
+
+    // Делит [0, count) на отрезки, границы которых кратны grain, и вызывает body(begin, end) для каждого
+    // отрезка в потоках пула. Возвращается, когда все отрезки обработаны; исключение из body пробрасывается
+    void parallel_for(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+private:
+    void _work();
+};
+
+#endif //AUTOMATA_THREAD_POOL_H